@@ -0,0 +1,174 @@
+//
+//  GuestEnvironment.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Foundation
+
+/// A guest's own environment variables. Each guest starts from a copy of
+/// maciOS's environment as it was when the first guest launched, plus the
+/// variables `Execute` sets for it, and its setenv calls only change its own
+/// copy. The hooks in EnvironmentHooks.swift send getenv, setenv, unsetenv,
+/// putenv and _NSGetEnviron from guest threads here, including GCD workers
+/// running a guest's block. Calls from any other thread go to the only
+/// running guest when there is exactly one, as they did when guests called
+/// setenv process-wide, and to maciOS's own environment otherwise.
+///
+/// Entries are kept as "NAME=value" C strings, which getenv and environ hand
+/// out directly. Copies share them until a guest replaces one, and replaced
+/// strings are never freed, as with libc, since a guest may still hold the
+/// pointer getenv gave it.
+final class GuestEnvironment {
+    private static let lock = NSLock()
+    private static var environments: [Int32: GuestEnvironment] = [:]
+
+    /// maciOS's environment when the first guest launched, shared by every
+    /// guest until it changes something.
+    private static let base: [String: UnsafeMutablePointer<CChar>] = ProcessInfo.processInfo.environment.reduce(into: [:]) { entries, variable in
+        entries[variable.key] = strdup("\(variable.key)=\(variable.value)")
+    }
+
+    /// Caches the calling thread's environment, retained, so a lookup only
+    /// goes through the shared table when the thread's guest changes. GCD
+    /// workers move between guests, so the cache is checked against `guest`.
+    private static let threadKey: pthread_key_t = {
+        var key = pthread_key_t()
+        pthread_key_create(&key) { value in
+            Unmanaged<GuestEnvironment>.fromOpaque(value).release()
+        }
+        return key
+    }()
+
+    let guest: Int32
+
+    private let lock = NSLock()
+    private var entries: [String: UnsafeMutablePointer<CChar>]
+    /// The array `_NSGetEnviron` points at; rebuilt when `entries` changes.
+    private var block: UnsafeMutablePointer<UnsafeMutablePointer<CChar>?>?
+    private var blockIsStale = true
+    private let environPointer = UnsafeMutablePointer<UnsafeMutablePointer<UnsafeMutablePointer<CChar>?>?>.allocate(capacity: 1)
+
+    private init(guest: Int32, entries: [String: UnsafeMutablePointer<CChar>]) {
+        self.guest = guest
+        self.entries = entries
+        environPointer.initialize(to: nil)
+    }
+
+    /// Creates guest `id`'s environment from the base one with `variables` on top.
+    @discardableResult
+    static func create(for id: Int32, variables: [String: String]) -> GuestEnvironment {
+        var entries = base
+        for (name, value) in variables {
+            entries[name] = strdup("\(name)=\(value)")
+        }
+
+        let environment = GuestEnvironment(guest: id, entries: entries)
+        lock.lock()
+        environments[id] = environment
+        lock.unlock()
+        return environment
+    }
+
+    /// Drops guest `id`'s environment once `GuestProcessTable` forgets the
+    /// guest. Its strings and `environ` array are left alone, since the
+    /// guest's code may still hold them, and a thread that cached it keeps
+    /// its reference until it moves on or exits.
+    static func remove(for id: Int32) {
+        lock.lock()
+        environments[id] = nil
+        lock.unlock()
+    }
+
+    /// The environment of the guest the calling thread belongs to; nil on
+    /// maciOS's own threads, which keep using the real one.
+    static var current: GuestEnvironment? {
+        let table = GuestProcessTable.shared
+        guard let guest = table.currentGuestID ?? table.soleLiveGuestID else { return nil }
+
+        let cached = pthread_getspecific(threadKey)
+        if let cached {
+            let environment = Unmanaged<GuestEnvironment>.fromOpaque(cached).takeUnretainedValue()
+            if environment.guest == guest {
+                return environment
+            }
+        }
+
+        lock.lock()
+        let environment = environments[guest]
+        lock.unlock()
+
+        if let environment {
+            pthread_setspecific(threadKey, Unmanaged.passRetained(environment).toOpaque())
+            if let cached {
+                Unmanaged<GuestEnvironment>.fromOpaque(cached).release()
+            }
+        }
+        return environment
+    }
+
+    // MARK: - libc
+
+    func get(_ name: UnsafePointer<CChar>) -> UnsafeMutablePointer<CChar>? {
+        let key = String(cString: name)
+        lock.lock()
+        defer { lock.unlock() }
+        return entries[key].map { $0 + key.utf8.count + 1 }
+    }
+
+    func set(_ name: UnsafePointer<CChar>, _ value: String, overwrite: Bool) {
+        let key = String(cString: name)
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard overwrite || entries[key] == nil else { return }
+        entries[key] = strdup("\(key)=\(value)")
+        blockIsStale = true
+    }
+
+    /// putenv takes the string itself, so later edits to it show through.
+    func put(_ string: UnsafeMutablePointer<CChar>) -> Bool {
+        let pair = String(cString: string)
+        guard let equals = pair.firstIndex(of: "=") else { return false }
+
+        lock.lock()
+        defer { lock.unlock() }
+        entries[String(pair[..<equals])] = string
+        blockIsStale = true
+        return true
+    }
+
+    func unset(_ name: UnsafePointer<CChar>) {
+        let key = String(cString: name)
+        lock.lock()
+        defer { lock.unlock() }
+
+        if entries.removeValue(forKey: key) != nil {
+            blockIsStale = true
+        }
+    }
+
+    /// What `_NSGetEnviron` returns: the address of this guest's `environ`.
+    var environ: UnsafeMutablePointer<UnsafeMutablePointer<UnsafeMutablePointer<CChar>?>?> {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if blockIsStale {
+            let block = UnsafeMutablePointer<UnsafeMutablePointer<CChar>?>.allocate(capacity: entries.count + 1)
+            var index = 0
+            for entry in entries.values {
+                block[index] = entry
+                index += 1
+            }
+            block[index] = nil
+
+            // libc frees the array it replaces too; the strings stay
+            self.block?.deallocate()
+            self.block = block
+            environPointer.pointee = block
+            blockIsStale = false
+        }
+        return environPointer
+    }
+}
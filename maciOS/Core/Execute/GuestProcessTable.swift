@@ -0,0 +1,275 @@
+//
+//  GuestProcessTable.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+
+/// The guests started by `Execute`, with pid-like IDs, their state and exit
+/// status, and CPU time summed over every thread they run.
+///
+/// A thread belongs to a guest when `Execute` started it for that guest or
+/// when a thread of the guest created it (see `install_thread_hooks`); the
+/// owning ID is kept in a pthread key, whose destructor books the thread's
+/// final CPU time when it ends, however it ends. GCD threads have no owner,
+/// so blocks a guest thread submits run through `run(as:_:)`, which lends
+/// the worker to the guest for the block and charges it the CPU time.
+///
+/// `GuestProcessView` reads `processes`, a snapshot rebuilt on every change,
+/// so a query only copies an array reference under the lock. Guests that have
+/// ended stay listed until dismissed there, or until more than
+/// `finishedLimit` have piled up; forgetting a guest also drops its
+/// `GuestEnvironment`.
+final class GuestProcessTable {
+    enum State: Equatable {
+        case starting
+        case running
+        /// The entry point returned or the guest called exit().
+        case exited(Int32)
+        case failed(String)
+    }
+
+    struct Process {
+        let id: Int32
+        let name: String
+        let path: String
+        let state: State
+        let startDate: Date
+        let endDate: Date?
+        /// Threads of the guest still alive.
+        let threadCount: Int
+        /// User and system time of every thread the guest has run, as of the
+        /// last `refreshUsage()`.
+        let cpuTime: TimeInterval
+
+        var exitCode: Int32? {
+            if case .exited(let code) = state { return code }
+            return nil
+        }
+
+        var isAlive: Bool {
+            state == .starting || state == .running
+        }
+    }
+
+    private final class Guest {
+        let id: Int32
+        let name: String
+        let path: String
+        var state = State.starting
+        let startDate = Date()
+        var endDate: Date?
+        /// Mach ports of live threads, each holding a send right.
+        var threads: [thread_act_t] = []
+        /// CPU time of threads that already ended.
+        var finishedCPUTime: TimeInterval = 0
+        var cpuTime: TimeInterval = 0
+
+        init(id: Int32, name: String, path: String) {
+            self.id = id
+            self.name = name
+            self.path = path
+        }
+
+        /// Ended, with no threads left that could still account to it.
+        var isFinished: Bool {
+            endDate != nil && threads.isEmpty
+        }
+
+        var snapshot: Process {
+            Process(id: id, name: name, path: path, state: state, startDate: startDate, endDate: endDate, threadCount: threads.count, cpuTime: cpuTime)
+        }
+    }
+
+    static let shared = GuestProcessTable()
+
+    /// Above any real pid, so guest IDs are never mistaken for one.
+    private static let firstID: Int32 = 100_000
+
+    /// Ended guests kept around to show how they ended.
+    private static let finishedLimit = 16
+
+    private let lock = NSLock()
+    private var guests: [Int32: Guest] = [:]
+    private var nextID = firstID
+    private var published: [Process] = []
+    private var soleLiveGuest: Int32?
+
+    /// Holds the guest ID of the current thread. Not a Swift thread-local, so
+    /// the thread hooks can read it cheaply and the destructor runs at exit.
+    let threadKey: pthread_key_t = {
+        var key = pthread_key_t()
+        pthread_key_create(&key) { value in
+            GuestProcessTable.shared.threadExited(Int32(Int(bitPattern: value)))
+        }
+        return key
+    }()
+
+    private init() {}
+
+    // MARK: - Queries
+
+    /// Every guest still running or not yet forgotten, oldest first.
+    var processes: [Process] {
+        lock.lock()
+        defer { lock.unlock() }
+        return published
+    }
+
+    /// The guest the calling thread belongs to, or nil for maciOS's own threads.
+    var currentGuestID: Int32? {
+        guard let value = pthread_getspecific(threadKey) else { return nil }
+        return Int32(Int(bitPattern: value))
+    }
+
+    /// The only guest still running, if exactly one is. Guest code called on
+    /// the main thread (AppKit callbacks, say) has no owner, and while one
+    /// guest runs it can only be that one's.
+    var soleLiveGuestID: Int32? {
+        lock.lock()
+        defer { lock.unlock() }
+        return soleLiveGuest
+    }
+
+    /// Re-reads the CPU time of every live guest thread, adds what GCD blocks
+    /// have been charged since, and returns the updated `processes`.
+    @discardableResult
+    func refreshUsage() -> [Process] {
+        mutate { guests in
+            for guest in guests.values {
+                guest.cpuTime = guest.finishedCPUTime + guest.threads.reduce(0) { $0 + Self.cpuTime(of: $1) }
+            }
+        }
+        return processes
+    }
+
+    // MARK: - Lifecycle
+
+    /// Adds a guest in the `.starting` state and returns its ID.
+    func register(name: String, path: String) -> Int32 {
+        var id: Int32 = 0
+        mutate { guests in
+            id = nextID
+            nextID += 1
+            guests[id] = Guest(id: id, name: name, path: path)
+        }
+        return id
+    }
+
+    /// Makes the calling thread part of guest `id`, and the guest running.
+    func attachCurrentThread(to id: Int32) {
+        let thread = mach_thread_self()
+        var attached = false
+
+        mutate { guests in
+            guard let guest = guests[id] else { return }
+            guest.threads.append(thread)
+            if guest.state == .starting {
+                guest.state = .running
+            }
+            attached = true
+        }
+
+        if attached {
+            pthread_setspecific(threadKey, UnsafeRawPointer(bitPattern: Int(id)))
+        } else {
+            mach_port_deallocate(mach_task_self_, thread)
+        }
+    }
+
+    /// Records how guest `id` ended. Only the first exit counts; threads
+    /// still running keep being accounted to the guest.
+    func finish(_ id: Int32, _ state: State) {
+        mutate { guests in
+            guard let guest = guests[id], guest.state == .starting || guest.state == .running else { return }
+            guest.state = state
+            guest.endDate = Date()
+        }
+    }
+
+    /// Runs `body` on the calling thread as part of guest `id`, for a block the
+    /// guest handed to GCD, and charges the thread's CPU time to the guest.
+    /// Whatever the thread belonged to before is restored afterwards.
+    func run(as id: Int32, _ body: () -> Void) {
+        let previous = pthread_getspecific(threadKey)
+        let thread = mach_thread_self()
+        let start = Self.cpuTime(of: thread)
+
+        pthread_setspecific(threadKey, UnsafeRawPointer(bitPattern: Int(id)))
+        body()
+        pthread_setspecific(threadKey, previous)
+
+        let time = Self.cpuTime(of: thread) - start
+        mach_port_deallocate(mach_task_self_, thread)
+
+        // Only the total moves, so the snapshot waits for the next refreshUsage()
+        lock.lock()
+        guests[id]?.finishedCPUTime += time
+        lock.unlock()
+    }
+
+    /// Forgets guest `id` if it has ended and none of its threads are left.
+    func remove(_ id: Int32) {
+        mutate { guests in
+            if let guest = guests[id], guest.isFinished {
+                guests[id] = nil
+            }
+        }
+    }
+
+    /// Called from the pthread key destructor on the exiting thread.
+    private func threadExited(_ id: Int32) {
+        let thread = mach_thread_self()
+        let time = Self.cpuTime(of: thread)
+
+        mutate { guests in
+            guard let guest = guests[id], let index = guest.threads.firstIndex(of: thread) else { return }
+            mach_port_deallocate(mach_task_self_, guest.threads.remove(at: index))
+            guest.finishedCPUTime += time
+            guest.cpuTime = guest.finishedCPUTime + guest.threads.reduce(0) { $0 + Self.cpuTime(of: $1) }
+        }
+        // mach_thread_self() added a reference of its own
+        mach_port_deallocate(mach_task_self_, thread)
+    }
+
+    private func mutate(_ body: (inout [Int32: Guest]) -> Void) {
+        lock.lock()
+        let before = Set(guests.keys)
+        body(&guests)
+
+        let finished = guests.values.filter(\.isFinished).map(\.id).sorted()
+        for id in finished.dropLast(Self.finishedLimit) {
+            guests[id] = nil
+        }
+
+        let forgotten = before.subtracting(guests.keys)
+        published = guests.values.sorted { $0.id < $1.id }.map(\.snapshot)
+        let live = published.filter(\.isAlive)
+        soleLiveGuest = live.count == 1 ? live[0].id : nil
+        lock.unlock()
+
+        // None of their threads are left to look the environment up
+        for id in forgotten {
+            GuestEnvironment.remove(for: id)
+        }
+    }
+
+    private static func cpuTime(of thread: thread_act_t) -> TimeInterval {
+        var info = thread_basic_info()
+        var count = mach_msg_type_number_t(MemoryLayout<thread_basic_info_data_t>.size / MemoryLayout<natural_t>.size)
+        let result = withUnsafeMutablePointer(to: &info) {
+            $0.withMemoryRebound(to: integer_t.self, capacity: Int(count)) {
+                thread_info(thread, thread_flavor_t(THREAD_BASIC_INFO), $0, &count)
+            }
+        }
+        guard result == KERN_SUCCESS else { return 0 }
+
+        func seconds(_ time: time_value_t) -> TimeInterval {
+            TimeInterval(time.seconds) + TimeInterval(time.microseconds) / 1_000_000
+        }
+        return seconds(info.user_time) + seconds(info.system_time)
+    }
+}
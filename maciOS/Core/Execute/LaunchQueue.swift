@@ -0,0 +1,267 @@
+//
+//  LaunchQueue.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Combine
+import Foundation
+import MachO
+
+/// One import on its way from the file picker to a running image.
+final class LaunchJob: ObservableObject, Identifiable {
+    enum Stage: Int, CaseIterable {
+        case queued
+        case importing
+        case hashing
+        case cacheLookup
+        case patching
+        case preflight
+        case loading
+        case finished
+        case failed
+        case cancelled
+
+        var title: String {
+            switch self {
+            case .queued: return "Waiting"
+            case .importing: return "Importing"
+            case .hashing: return "Hashing"
+            case .cacheLookup: return "Checking cache"
+            case .patching: return "Patching"
+            case .preflight: return "Checking image"
+            case .loading: return "Loading"
+            case .finished: return "Running"
+            case .failed: return "Failed"
+            case .cancelled: return "Cancelled"
+            }
+        }
+
+        var isTerminal: Bool {
+            self == .finished || self == .failed || self == .cancelled
+        }
+    }
+
+    let id = UUID()
+    let sourceURL: URL
+
+    @Published private(set) var stage: Stage = .queued
+    @Published private(set) var message: String?
+
+    /// Fraction of the pipeline behind this job, for a progress bar.
+    var progress: Double {
+        switch stage {
+        case .finished, .failed, .cancelled: return 1
+        default: return Double(stage.rawValue) / Double(Stage.finished.rawValue)
+        }
+    }
+
+    var name: String {
+        sourceURL.lastPathComponent
+    }
+
+    fileprivate weak var operation: Operation?
+
+    init(sourceURL: URL) {
+        self.sourceURL = sourceURL
+    }
+
+    /// Stops the job before its next stage. A stage already running finishes
+    /// (and its output stays in the cache), but nothing is loaded afterwards.
+    func cancel() {
+        operation?.cancel()
+        if stage == .queued {
+            stage = .cancelled
+        }
+    }
+
+    fileprivate func update(_ stage: Stage, message: String? = nil) {
+        DispatchQueue.main.async {
+            guard !self.stage.isTerminal else { return }
+            self.stage = stage
+            self.message = message
+        }
+    }
+}
+
+/// Runs imports through import, hash, cache lookup, patch, preflight and
+/// dlopen off the main thread. Several imports are patched at once; only the
+/// final dlopen hops to the main queue, because guest initializers may touch
+/// UIKit. Jobs publish one event per stage, so the UI only redraws a handful
+/// of times per launch.
+final class LaunchQueue: ObservableObject {
+    static let shared = LaunchQueue()
+
+    static let concurrencyDefaultsKey = "LaunchQueueConcurrency"
+
+    @Published private(set) var jobs: [LaunchJob] = []
+
+    private let queue: OperationQueue
+
+    init() {
+        queue = OperationQueue()
+        queue.name = "maciOS.launch-queue"
+        queue.qualityOfService = .userInitiated
+
+        // Patching is mostly memory bandwidth; past half the cores it just
+        // competes with the render thread.
+        let configured = UserDefaults.standard.integer(forKey: Self.concurrencyDefaultsKey)
+        queue.maxConcurrentOperationCount = configured > 0 ? configured : max(1, ProcessInfo.processInfo.activeProcessorCount / 2)
+    }
+
+    /// Queues `url` (a Mach-O or an .app bundle) for patching and launch.
+    /// `onPatched` is called on the main queue with the patcher for the image
+    /// that is about to be loaded.
+    @discardableResult
+    func enqueue(_ url: URL, onPatched: ((MachOPatcher) -> Void)? = nil) -> LaunchJob {
+        let job = LaunchJob(sourceURL: url)
+
+        let operation = BlockOperation()
+        operation.addExecutionBlock { [unowned operation] in
+            self.run(job, operation: operation, onPatched: onPatched)
+        }
+        operation.completionBlock = {
+            DispatchQueue.main.asyncAfter(deadline: .now() + 3) {
+                self.jobs.removeAll { $0.id == job.id && $0.stage != .failed }
+            }
+        }
+        job.operation = operation
+
+        jobs.append(job)
+        queue.addOperation(operation)
+        return job
+    }
+
+    func dismiss(_ job: LaunchJob) {
+        job.cancel()
+        jobs.removeAll { $0.id == job.id }
+    }
+
+    func cancelAll() {
+        jobs.forEach { $0.cancel() }
+    }
+
+    // MARK: - Pipeline
+
+    private func run(_ job: LaunchJob, operation: Operation, onPatched: ((MachOPatcher) -> Void)?) {
+        func proceed(to stage: LaunchJob.Stage) -> Bool {
+            guard !operation.isCancelled else {
+                NSLog("Launch of \(job.name) cancelled")
+                job.update(.cancelled)
+                return false
+            }
+            job.update(stage)
+            return true
+        }
+
+        func fail(_ message: String) {
+            NSLog("Launch of \(job.name) failed: \(message)")
+            job.update(.failed, message: message)
+        }
+
+        guard proceed(to: .importing) else { return }
+        let url = job.sourceURL
+        let accessing = url.startAccessingSecurityScopedResource()
+        defer {
+            if accessing { url.stopAccessingSecurityScopedResource() }
+        }
+
+        let patcher: MachOPatcher
+
+        if url.pathExtension == "app" {
+            // Bundles are hashed and patched as a whole, image by image, by
+            // BundlePatcher and cached in PatchedBundles rather than PatchCache
+            let bundle = BundlePatcher(url)
+
+            guard proceed(to: .hashing) else { return }
+            guard let key = bundle.cacheKey(), let executable = bundle.mainExecutableURL else {
+                return fail("Couldn't hash \(job.name)")
+            }
+
+            guard proceed(to: .cacheLookup) else { return }
+            var patched = bundle.cachedExecutable(for: key)
+            if patched == nil {
+                guard proceed(to: .patching) else { return }
+                patched = bundle.patch(key: key)
+            }
+            guard let patched else {
+                return fail("Couldn't patch \(job.name)")
+            }
+            patcher = MachOPatcher(executable, patchedURL: patched)
+        } else {
+            guard BundlePatcher.isMachO(at: url.path) else {
+                return fail("\(job.name) isn't a Mach-O")
+            }
+            patcher = MachOPatcher(url)
+
+            guard proceed(to: .hashing) else { return }
+            guard let key = patcher.cacheKey() else {
+                return fail("Couldn't hash \(job.name)")
+            }
+
+            guard proceed(to: .cacheLookup) else { return }
+            if patcher.cachedImage(for: key) == nil {
+                guard proceed(to: .patching) else { return }
+                guard patcher.patchIntoCache(key: key) != nil else {
+                    return fail("Couldn't patch \(job.name)")
+                }
+            }
+        }
+
+        guard proceed(to: .preflight) else { return }
+        do {
+            try Self.preflight(patcher.patchedURL)
+        } catch {
+            return fail("\(error)")
+        }
+
+        // Read from the original, whose install names are still the macOS ones
+        let interface = ObjCMetadata.read(patcher.fileURL.path)?.interface ?? .commandLine
+        NSLog("\(job.name) is a \(interface == .graphical ? "GUI app" : "command-line tool")")
+
+        guard proceed(to: .loading) else { return }
+        let started = DispatchQueue.main.sync {
+            onPatched?(patcher)
+            if interface == .commandLine {
+                WindowViewManager.shared.showTerminal()
+            }
+            install_exit_hook()
+            install_thread_hooks()
+            install_environment_hooks()
+            return Execute.run(dylibPath: patcher.patchedURL.path) != nil
+        }
+
+        if started {
+            job.update(.finished)
+        } else {
+            fail("Couldn't load \(patcher.patchedURL.lastPathComponent)")
+        }
+    }
+
+    /// Checks that catch a bad image before it reaches dlopen on the main
+    /// queue, so the failure shows up on the job instead of only in a dlerror
+    /// in the log, and lists everything missing rather than the first thing.
+    static func preflight(_ url: URL) throws {
+        let file = try MappedFile(path: url.path, writable: false)
+
+        guard let slice = try file.preferredARM64Slice() else {
+            throw MachOError("\(url.lastPathComponent) has no arm64 slice")
+        }
+        guard slice.header.pointee.filetype == UInt32(MH_DYLIB) || slice.header.pointee.filetype == UInt32(MH_BUNDLE) else {
+            throw MachOError("\(url.lastPathComponent) wasn't converted to a dylib")
+        }
+
+        if let build = slice.firstCommand(MachOLoadCommand.buildVersion, as: build_version_command.self),
+           build.pointee.platform != MachOPatcher.targetPlatform {
+            throw MachOError("\(url.lastPathComponent) targets platform \(build.pointee.platform)")
+        }
+
+        let report = DependencyAnalyzer().analyze(url)
+        NSLog("Dependencies of \(url.lastPathComponent): \(report.summary)")
+        guard report.isLoadable else {
+            let missing = report.missingLibraries.map { ($0.path as NSString).lastPathComponent } + report.missingSymbols.map(\.name)
+            throw MachOError("Missing \(missing.prefix(3).joined(separator: ", "))\(missing.count > 3 ? " and \(missing.count - 3) more" : "")")
+        }
+    }
+}
@@ -0,0 +1,158 @@
+//
+//  LoadedImageRegistry.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Foundation
+import MachO
+
+/// Every image dyld has loaded, kept up to date by dyld's add and remove
+/// image callbacks and indexed by header address and by path, so finding a
+/// guest after `dlopen` is a hash lookup instead of a scan over every image.
+///
+/// Images outside the shared cache are also indexed by their resolved path, so
+/// a guest is found however it was named and two guests with the same file
+/// name in different directories never match each other.
+final class LoadedImageRegistry {
+    struct Image {
+        let header: UnsafePointer<mach_header>
+        let slide: Int
+        /// The path dyld reports for the image.
+        let path: String
+    }
+
+    static let shared = LoadedImageRegistry()
+
+    private let lock = NSLock()
+    private var byHeader: [UnsafePointer<mach_header>: Image] = [:]
+    private var byPath: [String: UnsafePointer<mach_header>] = [:]
+    private var pathKeys: [UnsafePointer<mach_header>: [String]] = [:]
+    private var handles: [UnsafeMutableRawPointer: UnsafePointer<mach_header>] = [:]
+    private var descriptors: [UnsafePointer<mach_header>: MachOImageDescriptor] = [:]
+
+    /// What the dyld callbacks report to. Not `shared`: the add callback runs
+    /// for every loaded image before `_dyld_register_func_for_add_image`
+    /// returns, while `shared` is still being initialised.
+    private static var observer: LoadedImageRegistry?
+
+    private init() {
+        Self.observer = self
+
+        // Both run at once for the images already loaded, then on every dlopen and dlclose
+        _dyld_register_func_for_add_image { header, slide in
+            guard let header else { return }
+            LoadedImageRegistry.observer?.add(header, slide: slide)
+        }
+        _dyld_register_func_for_remove_image { header, _ in
+            guard let header else { return }
+            LoadedImageRegistry.observer?.remove(header)
+        }
+    }
+
+    /// Shared cache images are never guests, and resolving their paths would
+    /// cost a syscall each for the hundreds loaded at launch.
+    private static let inSharedCacheFlag: UInt32 = 0x80000000 // MH_DYLIB_IN_CACHE
+
+    private func add(_ header: UnsafePointer<mach_header>, slide: Int) {
+        var info = Dl_info()
+        guard dladdr(header, &info) != 0, let name = info.dli_fname else { return }
+
+        let path = String(cString: name)
+        var keys = [path]
+        if header.pointee.flags & Self.inSharedCacheFlag == 0, let resolved = Self.resolvedPath(path), resolved != path {
+            keys.append(resolved)
+        }
+
+        lock.lock()
+        defer { lock.unlock() }
+        byHeader[header] = Image(header: header, slide: slide, path: path)
+        pathKeys[header] = keys
+        for key in keys {
+            byPath[key] = header
+        }
+    }
+
+    private func remove(_ header: UnsafePointer<mach_header>) {
+        lock.lock()
+        defer { lock.unlock() }
+        guard byHeader.removeValue(forKey: header) != nil else { return }
+
+        descriptors[header] = nil
+        for key in pathKeys.removeValue(forKey: header) ?? [] where byPath[key] == header {
+            byPath[key] = nil
+        }
+        handles = handles.filter { $0.value != header }
+    }
+
+    // MARK: - Lookup
+
+    func image(at header: UnsafePointer<mach_header>) -> Image? {
+        lock.lock()
+        defer { lock.unlock() }
+        return byHeader[header]
+    }
+
+    /// The loaded image at `path`, by the name it was loaded under or its
+    /// resolved path.
+    func image(atPath path: String) -> Image? {
+        lock.lock()
+        if let header = byPath[path] {
+            defer { lock.unlock() }
+            return byHeader[header]
+        }
+        lock.unlock()
+
+        guard let resolved = Self.resolvedPath(path) else { return nil }
+
+        lock.lock()
+        defer { lock.unlock() }
+        return byPath[resolved].flatMap { byHeader[$0] }
+    }
+
+    /// `dlopen`, remembering which image the handle belongs to so
+    /// `image(for:)` can answer without asking dyld.
+    func open(_ path: String, mode: Int32) -> UnsafeMutableRawPointer? {
+        guard let handle = dlopen(path, mode) else { return nil }
+
+        if let image = image(atPath: path) {
+            lock.lock()
+            handles[handle] = image.header
+            lock.unlock()
+        }
+        return handle
+    }
+
+    /// The image behind a handle returned by `open(_:mode:)`.
+    func image(for handle: UnsafeMutableRawPointer) -> Image? {
+        lock.lock()
+        defer { lock.unlock() }
+        return handles[handle].flatMap { byHeader[$0] }
+    }
+
+    /// The descriptor of a loaded image, read once and kept until it is unloaded.
+    func descriptor(of image: Image) -> MachOImageDescriptor? {
+        lock.lock()
+        if let descriptor = descriptors[image.header] {
+            defer { lock.unlock() }
+            return descriptor
+        }
+        lock.unlock()
+
+        guard let descriptor = MachOImageDescriptor.load(image.path) else { return nil }
+
+        lock.lock()
+        defer { lock.unlock() }
+        if byHeader[image.header] != nil {
+            descriptors[image.header] = descriptor
+        }
+        return descriptor
+    }
+
+    private static func resolvedPath(_ path: String) -> String? {
+        guard let resolved = realpath(path, nil) else { return nil }
+        defer { free(resolved) }
+        return String(cString: resolved)
+    }
+}
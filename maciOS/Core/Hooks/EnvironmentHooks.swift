@@ -0,0 +1,113 @@
+//
+//  EnvironmentHooks.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Foundation
+
+typealias NSGetEnvironFunction = @convention(c) () -> UnsafeMutablePointer<UnsafeMutablePointer<UnsafeMutablePointer<CChar>?>?>?
+
+var original_getenv: UnsafeMutableRawPointer?
+var original_setenv: UnsafeMutableRawPointer?
+var original_unsetenv: UnsafeMutableRawPointer?
+var original_putenv: UnsafeMutableRawPointer?
+var original_NSGetEnviron: UnsafeMutableRawPointer?
+private var environmentHooksInstalled = false
+
+// Guest threads get their own guest's environment (see `GuestEnvironment`),
+// everything else the real one.
+
+@_cdecl("my_getenv")
+func my_getenv(_ name: UnsafePointer<CChar>?) -> UnsafeMutablePointer<CChar>? {
+    guard let name else { return nil }
+    if let environment = GuestEnvironment.current {
+        return environment.get(name)
+    }
+
+    let originalFunc = unsafeBitCast(original_getenv!, to: (@convention(c) (UnsafePointer<CChar>?) -> UnsafeMutablePointer<CChar>?).self)
+    return originalFunc(name)
+}
+
+@_cdecl("my_setenv")
+func my_setenv(_ name: UnsafePointer<CChar>?, _ value: UnsafePointer<CChar>?, _ overwrite: Int32) -> Int32 {
+    if let environment = GuestEnvironment.current {
+        guard let name, name.pointee != 0, strchr(name, Int32(UInt8(ascii: "="))) == nil else {
+            errno = EINVAL
+            return -1
+        }
+        environment.set(name, value.map { String(cString: $0) } ?? "", overwrite: overwrite != 0)
+        return 0
+    }
+
+    let originalFunc = unsafeBitCast(original_setenv!, to: (@convention(c) (UnsafePointer<CChar>?, UnsafePointer<CChar>?, Int32) -> Int32).self)
+    return originalFunc(name, value, overwrite)
+}
+
+@_cdecl("my_unsetenv")
+func my_unsetenv(_ name: UnsafePointer<CChar>?) -> Int32 {
+    if let environment = GuestEnvironment.current {
+        guard let name, name.pointee != 0, strchr(name, Int32(UInt8(ascii: "="))) == nil else {
+            errno = EINVAL
+            return -1
+        }
+        environment.unset(name)
+        return 0
+    }
+
+    let originalFunc = unsafeBitCast(original_unsetenv!, to: (@convention(c) (UnsafePointer<CChar>?) -> Int32).self)
+    return originalFunc(name)
+}
+
+@_cdecl("my_putenv")
+func my_putenv(_ string: UnsafeMutablePointer<CChar>?) -> Int32 {
+    if let environment = GuestEnvironment.current {
+        guard let string, environment.put(string) else {
+            errno = EINVAL
+            return -1
+        }
+        return 0
+    }
+
+    let originalFunc = unsafeBitCast(original_putenv!, to: (@convention(c) (UnsafeMutablePointer<CChar>?) -> Int32).self)
+    return originalFunc(string)
+}
+
+@_cdecl("my_NSGetEnviron")
+func my_NSGetEnviron() -> UnsafeMutablePointer<UnsafeMutablePointer<UnsafeMutablePointer<CChar>?>?>? {
+    if let environment = GuestEnvironment.current {
+        return environment.environ
+    }
+
+    let originalFunc = unsafeBitCast(original_NSGetEnviron!, to: NSGetEnvironFunction.self)
+    return originalFunc()
+}
+
+/// Safe to call on every launch; the hooks are only installed once.
+func install_environment_hooks() {
+    guard !environmentHooksInstalled else { return }
+    environmentHooksInstalled = true
+
+    let getenvReplacement = unsafeBitCast(my_getenv as @convention(c) (UnsafePointer<CChar>?) -> UnsafeMutablePointer<CChar>?, to: UnsafeMutableRawPointer.self)
+    let setenvReplacement = unsafeBitCast(my_setenv as @convention(c) (UnsafePointer<CChar>?, UnsafePointer<CChar>?, Int32) -> Int32, to: UnsafeMutableRawPointer.self)
+    let unsetenvReplacement = unsafeBitCast(my_unsetenv as @convention(c) (UnsafePointer<CChar>?) -> Int32, to: UnsafeMutableRawPointer.self)
+    let putenvReplacement = unsafeBitCast(my_putenv as @convention(c) (UnsafeMutablePointer<CChar>?) -> Int32, to: UnsafeMutableRawPointer.self)
+    let environReplacement = unsafeBitCast(my_NSGetEnviron as NSGetEnvironFunction, to: UnsafeMutableRawPointer.self)
+
+    var rebindings = [
+        rebinding(name: strdup("getenv"), replacement: getenvReplacement, replaced: &original_getenv),
+        rebinding(name: strdup("setenv"), replacement: setenvReplacement, replaced: &original_setenv),
+        rebinding(name: strdup("unsetenv"), replacement: unsetenvReplacement, replaced: &original_unsetenv),
+        rebinding(name: strdup("putenv"), replacement: putenvReplacement, replaced: &original_putenv),
+        rebinding(name: strdup("_NSGetEnviron"), replacement: environReplacement, replaced: &original_NSGetEnviron)
+    ]
+
+    let result = rebind_symbols(&rebindings, Int(rebindings.count))
+
+    if result == 0 {
+        NSLog("Successfully installed environment hooks")
+    } else {
+        NSLog("Failed to install environment hooks: %d", result)
+    }
+}
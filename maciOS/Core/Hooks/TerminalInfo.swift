@@ -179,6 +179,9 @@ func updateTerminalSize(rows: UInt16, cols: UInt16) {
 
 @_cdecl("my_exit")
 func my_exit(_ status: Int32) {
+    if let guest = GuestProcessTable.shared.currentGuestID {
+        GuestProcessTable.shared.finish(guest, .exited(status))
+    }
     pthread_exit(nil)
 }
 
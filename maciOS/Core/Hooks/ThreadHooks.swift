@@ -0,0 +1,102 @@
+//
+//  ThreadHooks.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Foundation
+
+/// The argument may be NULL, which Darwin's own pthread_create signature can't express.
+typealias ThreadStartRoutine = @convention(c) (UnsafeMutableRawPointer?) -> UnsafeMutableRawPointer?
+typealias PthreadCreate = @convention(c) (UnsafeMutablePointer<pthread_t?>?, UnsafePointer<pthread_attr_t>?, ThreadStartRoutine, UnsafeMutableRawPointer?) -> Int32
+typealias DispatchBlock = @convention(block) () -> Void
+/// The queue is only passed through, so it stays an opaque pointer.
+typealias DispatchAsync = @convention(c) (UnsafeMutableRawPointer?, @escaping DispatchBlock) -> Void
+typealias DispatchAfter = @convention(c) (UInt64, UnsafeMutableRawPointer?, @escaping DispatchBlock) -> Void
+
+var original_pthread_create: UnsafeMutableRawPointer?
+var original_dispatch_async: UnsafeMutableRawPointer?
+var original_dispatch_after: UnsafeMutableRawPointer?
+private var threadHooksInstalled = false
+
+/// What a guest thread was asked to run, carried into `guest_thread_start`.
+private final class GuestThreadStart {
+    let guest: Int32
+    let routine: ThreadStartRoutine
+    let argument: UnsafeMutableRawPointer?
+
+    init(guest: Int32, routine: @escaping ThreadStartRoutine, argument: UnsafeMutableRawPointer?) {
+        self.guest = guest
+        self.routine = routine
+        self.argument = argument
+    }
+}
+
+private let guest_thread_start: ThreadStartRoutine = { context in
+    let start = Unmanaged<GuestThreadStart>.fromOpaque(context!).takeRetainedValue()
+    GuestProcessTable.shared.attachCurrentThread(to: start.guest)
+    return start.routine(start.argument)
+}
+
+/// Threads created by a guest thread belong to the same guest. Everyone
+/// else's go straight through.
+@_cdecl("my_pthread_create")
+func my_pthread_create(_ thread: UnsafeMutablePointer<pthread_t?>?, _ attr: UnsafePointer<pthread_attr_t>?, _ routine: ThreadStartRoutine, _ argument: UnsafeMutableRawPointer?) -> Int32 {
+    let original = unsafeBitCast(original_pthread_create!, to: PthreadCreate.self)
+
+    guard let guest = GuestProcessTable.shared.currentGuestID else {
+        return original(thread, attr, routine, argument)
+    }
+
+    let context = Unmanaged.passRetained(GuestThreadStart(guest: guest, routine: routine, argument: argument)).toOpaque()
+    let result = original(thread, attr, guest_thread_start, context)
+    if result != 0 {
+        Unmanaged<GuestThreadStart>.fromOpaque(context).release()
+    }
+    return result
+}
+
+/// GCD runs a guest's blocks on threads nobody created for it, so a block
+/// submitted from a guest thread takes the guest along (see
+/// `GuestProcessTable.run(as:_:)`).
+private func guestBlock(_ block: @escaping DispatchBlock) -> DispatchBlock {
+    guard let guest = GuestProcessTable.shared.currentGuestID else { return block }
+    return {
+        GuestProcessTable.shared.run(as: guest, block)
+    }
+}
+
+@_cdecl("my_dispatch_async")
+func my_dispatch_async(_ queue: UnsafeMutableRawPointer?, _ block: @escaping DispatchBlock) {
+    let original = unsafeBitCast(original_dispatch_async!, to: DispatchAsync.self)
+    original(queue, guestBlock(block))
+}
+
+@_cdecl("my_dispatch_after")
+func my_dispatch_after(_ when: UInt64, _ queue: UnsafeMutableRawPointer?, _ block: @escaping DispatchBlock) {
+    let original = unsafeBitCast(original_dispatch_after!, to: DispatchAfter.self)
+    original(when, queue, guestBlock(block))
+}
+
+/// Safe to call on every launch; the hooks are only installed once.
+func install_thread_hooks() {
+    guard !threadHooksInstalled else { return }
+    threadHooksInstalled = true
+
+    let pthreadCreateReplacement = unsafeBitCast(my_pthread_create as PthreadCreate, to: UnsafeMutableRawPointer.self)
+    let dispatchAsyncReplacement = unsafeBitCast(my_dispatch_async as DispatchAsync, to: UnsafeMutableRawPointer.self)
+    let dispatchAfterReplacement = unsafeBitCast(my_dispatch_after as DispatchAfter, to: UnsafeMutableRawPointer.self)
+
+    var rebindings = [
+        rebinding(name: strdup("pthread_create"), replacement: pthreadCreateReplacement, replaced: &original_pthread_create),
+        rebinding(name: strdup("dispatch_async"), replacement: dispatchAsyncReplacement, replaced: &original_dispatch_async),
+        rebinding(name: strdup("dispatch_after"), replacement: dispatchAfterReplacement, replaced: &original_dispatch_after)
+    ]
+
+    if rebind_symbols(&rebindings, Int(rebindings.count)) == 0 {
+        NSLog("Successfully rebound pthread_create(), dispatch_async() and dispatch_after()")
+    } else {
+        NSLog("Failed to rebind thread hooks")
+    }
+}
@@ -0,0 +1,161 @@
+//
+//  PatcherBenchmark.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+#if DEBUG
+import Darwin
+import Foundation
+
+/// Times every `MachOPatcher` stage over a matrix of synthetic images and
+/// writes the results to `Documents/PatcherBenchmark-<date>.json`.
+///
+/// Launch with `-RunPatcherBenchmark YES`. `-PatcherBenchmarkSizesMB 1,64,4096`
+/// and `-PatcherBenchmarkIterations 5` change the matrix; both are read from
+/// UserDefaults, so they also work as launch arguments in the scheme.
+enum PatcherBenchmark {
+    static let runDefaultsKey = "RunPatcherBenchmark"
+    static let sizesDefaultsKey = "PatcherBenchmarkSizesMB"
+    static let iterationsDefaultsKey = "PatcherBenchmarkIterations"
+
+    struct StageResult: Codable {
+        let stage: String
+        let succeeded: Bool
+        let minNanoseconds: UInt64
+        let medianNanoseconds: UInt64
+        let meanNanoseconds: UInt64
+    }
+
+    struct CaseResult: Codable {
+        let name: String
+        let parameters: SyntheticMachO.Parameters
+        let fileSize: Int
+        let stages: [StageResult]
+    }
+
+    struct Report: Codable {
+        let date: Date
+        let machine: String
+        let systemVersion: String
+        let iterations: Int
+        let cases: [CaseResult]
+    }
+
+    /// The pipeline in the order `patchExecutable` runs it.
+    private static let stages: [(name: String, run: (MachOPatcher) -> Bool)] = [
+        ("copy", { $0.copyOriginalFile() }),
+        ("dylibConversion", { $0.convertToDylib() != nil }),
+        ("platform", { $0.patchPlatform(targetPlatform: Int32(MachOPatcher.targetPlatform)) != nil }),
+        ("frameworkRemap", { $0.patchKnownFrameworks(); return true }),
+        ("symbols", { $0.patchSymbols(remove: MachOPatcher.defaultSymbolsToRemove, weaken: ["_synthetic_symbol_100"]) }),
+        ("bindDecode", { patcher in
+            guard let file = try? MappedFile(path: patcher.patchedURL.path, writable: false),
+                  let slice = try? file.preferredARM64Slice() else { return false }
+            return (try? DyldInfoBinds.count(in: slice)) != nil
+        }),
+        ("importRedirect", { $0.redirectImports(["_CGMainDisplayID"], to: "@rpath/CoreGraphics.dylib") }),
+        ("adHocSign", { $0.signPatchedImage() }),
+    ]
+
+    static var isRequested: Bool {
+        UserDefaults.standard.bool(forKey: runDefaultsKey)
+    }
+
+    static func runInBackground() {
+        DispatchQueue.global(qos: .utility).async {
+            let configured = UserDefaults.standard.integer(forKey: iterationsDefaultsKey)
+            let report = run(matrix(), iterations: configured > 0 ? configured : 5)
+
+            let formatter = ISO8601DateFormatter()
+            formatter.formatOptions = [.withFullDate, .withTime]
+            let url = URL.documentsDirectory.appendingPathComponent("PatcherBenchmark-\(formatter.string(from: report.date)).json")
+
+            do {
+                let encoder = JSONEncoder()
+                encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+                encoder.dateEncodingStrategy = .iso8601
+                try encoder.encode(report).write(to: url, options: .atomic)
+                NSLog("Patcher benchmark written to \(url.path)")
+            } catch {
+                NSLog("Failed to write patcher benchmark: \(error)")
+            }
+        }
+    }
+
+    /// Thin and fat, roomy and tight, with and without chained fixups, at each
+    /// size; plus a symbol-heavy image for the symbol table stage.
+    static func matrix() -> [SyntheticMachO.Parameters] {
+        let sizes = (UserDefaults.standard.string(forKey: sizesDefaultsKey) ?? "1,64,512")
+            .split(separator: ",")
+            .compactMap { Int($0.trimmingCharacters(in: .whitespaces)) }
+
+        var matrix: [SyntheticMachO.Parameters] = []
+        for megabytes in sizes {
+            let size = megabytes << 20
+            matrix.append(.init(size: size, fat: false, loadCommands: 16, symbols: 10_000, chainedFixups: true, roomyHeader: true))
+            matrix.append(.init(size: size, fat: true, loadCommands: 16, symbols: 10_000, chainedFixups: true, roomyHeader: true))
+            matrix.append(.init(size: size, fat: false, loadCommands: 64, symbols: 10_000, chainedFixups: false, roomyHeader: false))
+        }
+        matrix.append(.init(size: 1 << 20, fat: false, loadCommands: 16, symbols: 500_000, chainedFixups: true, roomyHeader: true))
+        return matrix
+    }
+
+    static func run(_ matrix: [SyntheticMachO.Parameters], iterations: Int) -> Report {
+        let directory = FileManager.default.temporaryDirectory.appendingPathComponent("PatcherBenchmark-\(UUID().uuidString)")
+        try? FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        defer { try? FileManager.default.removeItem(at: directory) }
+
+        var cases: [CaseResult] = []
+
+        for parameters in matrix {
+            let input = directory.appendingPathComponent(parameters.name)
+            let output = directory.appendingPathComponent(parameters.name + ".dylib")
+
+            do {
+                try SyntheticMachO.write(parameters, to: input.path)
+            } catch {
+                NSLog("Skipping benchmark case \(parameters.name): \(error)")
+                continue
+            }
+
+            var timings = [[UInt64]](repeating: [], count: stages.count)
+            var succeeded = [Bool](repeating: true, count: stages.count)
+
+            for _ in 0..<iterations {
+                let patcher = MachOPatcher(input, patchedURL: output)
+
+                for (index, stage) in stages.enumerated() {
+                    let start = DispatchTime.now().uptimeNanoseconds
+                    let ok = stage.run(patcher)
+                    timings[index].append(DispatchTime.now().uptimeNanoseconds - start)
+                    succeeded[index] = succeeded[index] && ok
+                }
+            }
+
+            let fileSize = (try? FileManager.default.attributesOfItem(atPath: input.path)[.size] as? Int) ?? 0
+            let results = stages.indices.map { index -> StageResult in
+                let samples = timings[index].sorted()
+                return StageResult(
+                    stage: stages[index].name,
+                    succeeded: succeeded[index],
+                    minNanoseconds: samples.first ?? 0,
+                    medianNanoseconds: samples.isEmpty ? 0 : samples[samples.count / 2],
+                    meanNanoseconds: samples.isEmpty ? 0 : samples.reduce(0, +) / UInt64(samples.count)
+                )
+            }
+
+            cases.append(CaseResult(name: parameters.name, parameters: parameters, fileSize: fileSize, stages: results))
+            try? FileManager.default.removeItem(at: input)
+            try? FileManager.default.removeItem(at: output)
+        }
+
+        var name = utsname()
+        uname(&name)
+        let machine = withUnsafeBytes(of: name.machine) { String(decoding: $0.prefix { $0 != 0 }, as: UTF8.self) }
+
+        return Report(date: Date(), machine: machine, systemVersion: ProcessInfo.processInfo.operatingSystemVersionString, iterations: iterations, cases: cases)
+    }
+}
+#endif
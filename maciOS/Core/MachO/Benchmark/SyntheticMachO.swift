@@ -0,0 +1,323 @@
+//
+//  SyntheticMachO.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+#if DEBUG
+import Darwin
+import Foundation
+import MachO
+
+/// Writes synthetic macOS arm64 executables shaped like the ones maciOS
+/// patches, for benchmarking the patcher without shipping real binaries.
+/// `__text` is left sparse, so even multi-gigabyte images are quick to create
+/// and take almost no disk space.
+struct SyntheticMachO {
+    struct Parameters: Codable {
+        var size = 1 << 20
+        var fat = false
+        /// Extra LC_LOAD_DYLIB commands, drawn from the remap rules first.
+        var loadCommands = 16
+        var symbols = 10_000
+        /// Imports as chained fixups, or else as LC_DYLD_INFO_ONLY bind opcodes.
+        var chainedFixups = true
+        /// A roomy header leaves 16 KB of padding; a tight one leaves none.
+        var roomyHeader = true
+
+        var name: String {
+            "\(fat ? "fat" : "thin")-\(size >> 20)MB-\(loadCommands)lc-\(symbols)sym-\(chainedFixups ? "fixups" : "nofixups")-\(roomyHeader ? "roomy" : "tight")"
+        }
+    }
+
+    private static let textVMAddr: UInt64 = 0x100000000
+    private static let pageSize = 0x4000
+
+    /// Header, load commands, string literals and __LINKEDIT of one image,
+    /// plus where each of them goes.
+    private struct Image {
+        var header: [UInt8]
+        var cstrings: [UInt8]
+        var cstringOffset: Int
+        var textOffset: Int
+        var linkedit: [UInt8]
+        var linkeditOffset: Int
+        var size: Int
+    }
+
+    static func write(_ parameters: Parameters, to path: String) throws {
+        let image = makeImage(parameters)
+
+        let fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0o644)
+        guard fd >= 0 else {
+            throw MachOError.posix("Failed to create", path)
+        }
+        defer { close(fd) }
+
+        if parameters.fat {
+            // An x86_64 slice first, so the arm64 one has to be found
+            let first = pageSize
+            let second = align(first + image.size, pageSize)
+            let is64 = second + image.size > Int(UInt32.max)
+
+            var fat = ByteWriter()
+            fat.u32(UInt32(bigEndian: is64 ? FAT_MAGIC_64 : FAT_MAGIC))
+            fat.u32(UInt32(bigEndian: 2))
+            for (cputype, subtype, offset) in [(CPU_TYPE_X86_64, CPU_SUBTYPE_X86_64_ALL, first), (CPU_TYPE_ARM64, CPU_SUBTYPE_ARM64_ALL, second)] {
+                fat.u32(UInt32(bigEndian: UInt32(bitPattern: cputype)))
+                fat.u32(UInt32(bigEndian: UInt32(bitPattern: subtype)))
+                if is64 {
+                    fat.u64(UInt64(bigEndian: UInt64(offset)))
+                    fat.u64(UInt64(bigEndian: UInt64(image.size)))
+                    fat.u32(UInt32(bigEndian: 14))
+                    fat.u32(0)
+                } else {
+                    fat.u32(UInt32(bigEndian: UInt32(offset)))
+                    fat.u32(UInt32(bigEndian: UInt32(image.size)))
+                    fat.u32(UInt32(bigEndian: 14))
+                }
+            }
+
+            try write(fat.bytes, fd, at: 0, path)
+            var x86 = image
+            x86.header.withUnsafeMutableBytes { raw in
+                raw.storeBytes(of: UInt32(bitPattern: CPU_TYPE_X86_64), toByteOffset: 4, as: UInt32.self)
+                raw.storeBytes(of: UInt32(bitPattern: CPU_SUBTYPE_X86_64_ALL), toByteOffset: 8, as: UInt32.self)
+            }
+            try write(x86, fd, at: first, path)
+            try write(image, fd, at: second, path)
+            try resize(fd, second + image.size, path)
+        } else {
+            try write(image, fd, at: 0, path)
+            try resize(fd, image.size, path)
+        }
+    }
+
+    private static func makeImage(_ parameters: Parameters) -> Image {
+        let rules = FrameworkRemapRules.bundled.exactPaths
+        let dylibs = (0..<parameters.loadCommands).map { i in
+            i < rules.count ? rules[i] : "/usr/lib/libsynthetic\(i).dylib"
+        }
+        let symbolNames = (0..<parameters.symbols).map { i in
+            i < MachOPatcher.defaultSymbolsToRemove.count ? MachOPatcher.defaultSymbolsToRemove[i] : "_synthetic_symbol_\(i)"
+        }
+
+        // String literals the framework string remapper has to find
+        var cstrings = ByteWriter()
+        for rule in rules {
+            cstrings.cString(rule)
+        }
+
+        // __LINKEDIT contents, laid out relative to its start
+        var linkedit = ByteWriter()
+        var bindRanges: [(offset: Int, size: Int)] = []
+        if parameters.chainedFixups {
+            linkedit.bytes = chainedFixups(imports: symbolNames, libraries: max(dylibs.count, 1))
+            linkedit.align(8)
+        } else {
+            for stream in bindOpcodes(imports: symbolNames, libraries: max(dylibs.count, 1)) {
+                bindRanges.append((linkedit.count, stream.count))
+                linkedit.bytes += stream
+                linkedit.align(8)
+            }
+        }
+        let symbolsOffset = linkedit.count
+
+        var strings = ByteWriter()
+        strings.bytes = [0x20, 0]
+        for (i, name) in symbolNames.enumerated() {
+            linkedit.u32(UInt32(strings.count))
+            linkedit.u8(UInt8(N_UNDF | N_EXT))
+            linkedit.u8(0)
+            linkedit.u16(UInt16(min(i % max(dylibs.count, 1) + 1, 255)) << 8)
+            linkedit.u64(0)
+            strings.cString(name)
+        }
+        strings.align(8)
+        let stringsOffset = linkedit.count
+        linkedit.bytes += strings.bytes
+
+        // Load command sizes first; every file offset depends on them
+        let dylibCommands = dylibs.map { MachOSlice.dylibCommand(MachOLoadCommand.loadDylib, path: $0) }
+        let commandsSize = 72 + (72 + 2 * 80) + 72 + (parameters.chainedFixups ? 16 : 48) + 24 + 80 + 24 + 24 + dylibCommands.reduce(0) { $0 + $1.count }
+        let headerEnd = MemoryLayout<mach_header_64>.size + commandsSize
+
+        let textOffset = align(headerEnd + (parameters.roomyHeader ? pageSize : 0), 16)
+        // Section and __LINKEDIT offsets are 32-bit, so "4 GB" stops just short of it
+        let size = min(parameters.size, Int(UInt32.max) - (1 << 26))
+        let textSize = align(max(4, size - textOffset - cstrings.count - linkedit.count), 4)
+        let cstringOffset = textOffset + textSize
+        let textSegmentSize = align(cstringOffset + cstrings.count, pageSize)
+        let linkeditOffset = textSegmentSize
+        let fileSize = linkeditOffset + linkedit.count
+
+        var header = ByteWriter()
+        header.u32(MH_MAGIC_64)
+        header.u32(UInt32(bitPattern: CPU_TYPE_ARM64))
+        header.u32(UInt32(bitPattern: CPU_SUBTYPE_ARM64_ALL))
+        header.u32(UInt32(MH_EXECUTE))
+        header.u32(UInt32(8 + dylibCommands.count))
+        header.u32(UInt32(commandsSize))
+        header.u32(UInt32(MH_PIE | MH_DYLDLINK | MH_TWOLEVEL))
+        header.u32(0)
+
+        header.segment("__PAGEZERO", vmaddr: 0, vmsize: textVMAddr, fileoff: 0, filesize: 0, prot: 0, sections: 0)
+
+        header.segment("__TEXT", vmaddr: textVMAddr, vmsize: UInt64(textSegmentSize), fileoff: 0, filesize: UInt64(textSegmentSize), prot: 5, sections: 2)
+        header.section("__text", "__TEXT", addr: textVMAddr + UInt64(textOffset), size: textSize, offset: textOffset, align: 2, flags: 0x80000400)
+        header.section("__cstring", "__TEXT", addr: textVMAddr + UInt64(cstringOffset), size: cstrings.count, offset: cstringOffset, align: 0, flags: UInt32(S_CSTRING_LITERALS))
+
+        header.segment("__LINKEDIT", vmaddr: textVMAddr + UInt64(textSegmentSize), vmsize: UInt64(align(linkedit.count, pageSize)), fileoff: UInt64(linkeditOffset), filesize: UInt64(linkedit.count), prot: 1, sections: 0)
+
+        if parameters.chainedFixups {
+            header.u32(MachOLoadCommand.dyldChainedFixups)
+            header.u32(16)
+            header.u32(UInt32(linkeditOffset))
+            header.u32(UInt32(symbolsOffset))
+        } else {
+            // Binds point into __TEXT; the benchmark never loads the image
+            header.u32(MachOLoadCommand.dyldInfoOnly)
+            header.u32(48)
+            header.u32(0)
+            header.u32(0)
+            for range in [bindRanges[0], (offset: 0, size: 0), bindRanges[1]] {
+                header.u32(range.size > 0 ? UInt32(linkeditOffset + range.offset) : 0)
+                header.u32(UInt32(range.size))
+            }
+            header.u32(0)
+            header.u32(0)
+        }
+
+        header.u32(MachOLoadCommand.symtab)
+        header.u32(24)
+        header.u32(UInt32(linkeditOffset + symbolsOffset))
+        header.u32(UInt32(symbolNames.count))
+        header.u32(UInt32(linkeditOffset + stringsOffset))
+        header.u32(UInt32(strings.count))
+
+        // LC_DYSYMTAB: every symbol is undefined
+        header.u32(MachOLoadCommand.dysymtab)
+        header.u32(80)
+        for field in [0, 0, 0, 0, 0, symbolNames.count] + [Int](repeating: 0, count: 12) {
+            header.u32(UInt32(field))
+        }
+
+        header.u32(MachOLoadCommand.buildVersion)
+        header.u32(24)
+        header.u32(UInt32(PLATFORM_MACOS))
+        header.u32(0x000d0000)
+        header.u32(0x000d0000)
+        header.u32(0)
+
+        header.u32(MachOLoadCommand.main)
+        header.u32(24)
+        header.u64(UInt64(textOffset))
+        header.u64(0)
+
+        for command in dylibCommands {
+            header.bytes += command
+        }
+
+        return Image(header: header.bytes, cstrings: cstrings.bytes, cstringOffset: cstringOffset, textOffset: textOffset, linkedit: linkedit.bytes, linkeditOffset: linkeditOffset, size: fileSize)
+    }
+
+    /// A fixups blob with no pointer chains, just the imports table, which is
+    /// all the patcher ever reads or rewrites.
+    private static func chainedFixups(imports: [String], libraries: Int) -> [UInt8] {
+        var pool = ByteWriter()
+        let nameOffsets = imports.map { name -> Int in
+            defer { pool.cString(name) }
+            return pool.count
+        }
+        let wide = pool.count >= 1 << 23
+        let entrySize = wide ? 16 : 4
+
+        let startsOffset = 32
+        let segmentCount = 3
+        let importsOffset = startsOffset + 4 + segmentCount * 4
+        let symbolsOffset = importsOffset + imports.count * entrySize
+
+        var blob = ByteWriter()
+        blob.u32(0)
+        blob.u32(UInt32(startsOffset))
+        blob.u32(UInt32(importsOffset))
+        blob.u32(UInt32(symbolsOffset))
+        blob.u32(UInt32(imports.count))
+        blob.u32(wide ? 3 : 1)
+        blob.u32(0)
+        blob.align(8)
+
+        blob.u32(UInt32(segmentCount))
+        for _ in 0..<segmentCount {
+            blob.u32(0)
+        }
+
+        for (i, offset) in nameOffsets.enumerated() {
+            let ordinal = min(i % libraries + 1, 0xf0)
+            if wide {
+                blob.u64(UInt64(ordinal) | UInt64(offset) << 32)
+                blob.u64(0)
+            } else {
+                blob.u32(UInt32(ordinal) | UInt32(offset) << 9)
+            }
+        }
+
+        blob.bytes += pool.bytes
+        return blob.bytes
+    }
+
+    /// A bind stream for the first half of `imports` and a lazy bind stream for
+    /// the rest, one pointer each, laid out like ld's output.
+    private static func bindOpcodes(imports: [String], libraries: Int) -> [[UInt8]] {
+        let half = imports.count / 2
+        let ordinal = { (i: Int) in min(i % libraries + 1, 0xf0) }
+
+        let binds = imports[..<half].enumerated().map { i, name in
+            DyldInfoBinds.Bind(libraryOrdinal: ordinal(i), name: name, flags: 0, type: UInt8(BIND_TYPE_POINTER), addend: 0, segmentIndex: 1, segmentOffset: UInt64(i) * 8)
+        }
+
+        var lazy = ByteWriter()
+        for (i, name) in imports[half...].enumerated() {
+            let library = ordinal(half + i)
+            lazy.u8(UInt8(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB) | 1)
+            lazy.uleb(UInt64(half + i) * 8)
+            if library <= 15 {
+                lazy.u8(UInt8(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM) | UInt8(library))
+            } else {
+                lazy.u8(UInt8(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB))
+                lazy.uleb(UInt64(library))
+            }
+            lazy.u8(UInt8(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM))
+            lazy.cString(name)
+            lazy.u8(UInt8(BIND_OPCODE_DO_BIND))
+            lazy.u8(UInt8(BIND_OPCODE_DONE))
+        }
+
+        return [DyldInfoBinds.encode(binds), lazy.bytes]
+    }
+
+    private static func write(_ image: Image, _ fd: Int32, at base: Int, _ path: String) throws {
+        try write(image.header, fd, at: base, path)
+        try write([0xc0, 0x03, 0x5f, 0xd6], fd, at: base + image.textOffset, path) // ret
+        try write(image.cstrings, fd, at: base + image.cstringOffset, path)
+        try write(image.linkedit, fd, at: base + image.linkeditOffset, path)
+    }
+
+    private static func write(_ bytes: [UInt8], _ fd: Int32, at offset: Int, _ path: String) throws {
+        guard bytes.isEmpty || pwrite(fd, bytes, bytes.count, off_t(offset)) == bytes.count else {
+            throw MachOError.posix("Failed to write", path)
+        }
+    }
+
+    private static func resize(_ fd: Int32, _ size: Int, _ path: String) throws {
+        guard ftruncate(fd, off_t(size)) == 0 else {
+            throw MachOError.posix("Failed to resize", path)
+        }
+    }
+
+    private static func align(_ value: Int, _ alignment: Int) -> Int {
+        (value + alignment - 1) / alignment * alignment
+    }
+}
+#endif
@@ -0,0 +1,472 @@
+//
+//  BundlePatcher.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import CryptoKit
+import Darwin
+import Foundation
+import MachO
+
+/// Patches a whole macOS .app: the main executable plus every framework,
+/// plugin, helper and loose dylib inside it. The bundle is cloned into a
+/// staging directory, every Mach-O in it is patched in parallel, a manifest
+/// describing what was found, how it links and how long it took is written
+/// next to the copy, and the result is published with a rename as
+/// `Caches/PatchedBundles/<key>/<bundle>`. The key covers every Mach-O in the
+/// bundle, so relaunching the same bundle reuses the copy, and a copy that is
+/// running is never replaced underneath it.
+final class BundlePatcher {
+    static let manifestName = "maciOS-manifest.json"
+
+    /// Part of the cache key; bump whenever the way patched images in a
+    /// bundle refer to each other changes, so older copies aren't reused.
+    static let layoutVersion = 2
+
+    struct Manifest: Codable {
+        struct Entry: Codable {
+            /// Relative to the bundle root.
+            let path: String
+            let kind: MachOImageKind
+            let size: Int
+            /// Images inside the bundle this one links against, relative to the bundle root.
+            var dependencies: [String]
+            /// Install names that don't resolve to anything in the bundle.
+            var external: [String]
+            var patched: Bool
+            var milliseconds: Double
+        }
+
+        let bundle: String
+        let mainExecutable: String
+        var entries: [Entry]
+        /// Dependencies first, so each image comes after everything it links.
+        var loadOrder: [String]
+        var milliseconds: Double
+    }
+
+    private struct Image {
+        let relativePath: String
+        let kind: MachOImageKind
+        let size: Int
+        let installNames: [String]
+        let rpaths: [String]
+    }
+
+    let bundleURL: URL
+    /// Holds one directory per key with the patched copy inside.
+    let outputDirectory: URL
+    private(set) var manifest: Manifest?
+
+    init(_ bundleURL: URL, outputDirectory: URL = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0].appendingPathComponent("PatchedBundles")) {
+        self.bundleURL = bundleURL.standardizedFileURL
+        self.outputDirectory = outputDirectory
+    }
+
+    /// Where the copy patched for `key` lives once published.
+    func outputURL(for key: String) -> URL {
+        outputDirectory.appendingPathComponent(key, isDirectory: true).appendingPathComponent(bundleURL.lastPathComponent)
+    }
+
+    /// What every image's remap rule overrides are looked up under.
+    private var appName: String {
+        bundleURL.deletingPathExtension().lastPathComponent
+    }
+
+    /// The main executable named by Info.plist, falling back to the only file in Contents/MacOS.
+    lazy var mainExecutableURL: URL? = {
+        let contents = bundleURL.appendingPathComponent("Contents")
+        let macOS = contents.appendingPathComponent("MacOS")
+
+        if let info = NSDictionary(contentsOf: contents.appendingPathComponent("Info.plist")),
+           let name = info["CFBundleExecutable"] as? String {
+            return macOS.appendingPathComponent(name)
+        }
+
+        let candidates = (try? FileManager.default.contentsOfDirectory(at: macOS, includingPropertiesForKeys: nil)) ?? []
+        return candidates.first { Self.isMachO(at: $0.path) }
+    }()
+
+    /// Returns the patched main executable, reusing the copy from an earlier
+    /// launch when the bundle and the patch rules haven't changed.
+    func patch() -> URL? {
+        guard let key = cacheKey() else { return nil }
+        return cachedExecutable(for: key) ?? patch(key: key)
+    }
+
+    /// The main executable's `PatchCache` key, with the digest of every other
+    /// Mach-O in the bundle folded into the rule version so an updated
+    /// framework gets a fresh copy too.
+    func cacheKey() -> String? {
+        guard let mainExecutableURL else {
+            NSLog("No main executable found in \(bundleURL.lastPathComponent)")
+            return nil
+        }
+
+        let cache = PatchCache.shared
+        do {
+            var hasher = SHA256()
+            for file in machOFiles.sorted(by: { $0.url.path < $1.url.path }) {
+                let digest = try cache.contentDigest(of: file.url)
+                hasher.update(data: Data("\(relativePath(of: file.url))|\(digest)\n".utf8))
+            }
+            let images = hasher.finalize().map { String(format: "%02x", $0) }.joined()
+
+            // The rules the images are patched with, overrides included
+            let rules = MachOPatcher(mainExecutableURL)
+            rules.appName = appName
+            return try cache.key(for: mainExecutableURL, ruleVersion: "\(rules.ruleSetVersion)|bundle \(Self.layoutVersion) \(images)")
+        } catch {
+            NSLog("Error hashing \(bundleURL.lastPathComponent): \(error)")
+            return nil
+        }
+    }
+
+    /// The main executable of a copy already published for `key`, if its
+    /// manifest says the main executable was patched.
+    func cachedExecutable(for key: String) -> URL? {
+        let output = outputURL(for: key)
+        guard let data = try? Data(contentsOf: output.appendingPathComponent(Self.manifestName)),
+              let manifest = try? JSONDecoder().decode(Manifest.self, from: data),
+              manifest.entries.first(where: { $0.path == manifest.mainExecutable })?.patched == true else { return nil }
+
+        NSLog("Using patched copy of \(bundleURL.lastPathComponent)")
+        try? FileManager.default.setAttributes([.modificationDate: Date()], ofItemAtPath: output.deletingLastPathComponent().path)
+        self.manifest = manifest
+        return output.appendingPathComponent(manifest.mainExecutable)
+    }
+
+    /// Patches the bundle into a staging directory beside the final one and
+    /// publishes it as the copy for `key`. Nothing already published is ever
+    /// removed, since a guest may be running from it.
+    func patch(key: String) -> URL? {
+        let start = DispatchTime.now()
+
+        guard let mainExecutableURL else {
+            NSLog("No main executable found in \(bundleURL.lastPathComponent)")
+            return nil
+        }
+
+        let fileManager = FileManager.default
+        let output = outputURL(for: key)
+        let stagingDirectory = outputDirectory.appendingPathComponent(".\(key)-\(UUID().uuidString)", isDirectory: true)
+        let staging = stagingDirectory.appendingPathComponent(bundleURL.lastPathComponent)
+        // Gone already once published
+        defer { try? fileManager.removeItem(at: stagingDirectory) }
+
+        do {
+            try fileManager.createDirectory(at: stagingDirectory, withIntermediateDirectories: true)
+            // APFS clones each file, so the untouched resources cost no space
+            try fileManager.copyItem(at: bundleURL, to: staging)
+        } catch {
+            NSLog("Error copying \(bundleURL.lastPathComponent): \(error)")
+            return nil
+        }
+
+        let mainPath = relativePath(of: mainExecutableURL)
+        let images = discoverImages()
+
+        guard images.contains(where: { $0.relativePath == mainPath }) else {
+            NSLog("\(mainPath) is not a loadable Mach-O")
+            return nil
+        }
+
+        var entries = resolveDependencies(of: images, mainPath: mainPath)
+        patchImages(images, into: &entries, mainPath: mainPath, staging: staging)
+
+        var manifest = Manifest(
+            bundle: bundleURL.lastPathComponent,
+            mainExecutable: mainPath,
+            entries: entries,
+            loadOrder: Self.loadOrder(of: entries),
+            milliseconds: 0
+        )
+        manifest.milliseconds = Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000
+        self.manifest = manifest
+
+        do {
+            let encoder = JSONEncoder()
+            encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+            try encoder.encode(manifest).write(to: staging.appendingPathComponent(Self.manifestName), options: .atomic)
+        } catch {
+            NSLog("Error writing bundle manifest: \(error)")
+        }
+
+        let failed = entries.filter { !$0.patched }.map(\.path)
+        if !failed.isEmpty {
+            NSLog("Failed to patch \(failed.count) image(s): \(failed.joined(separator: ", "))")
+        }
+
+        guard entries.first(where: { $0.path == mainPath })?.patched == true else { return nil }
+
+        // If another launch of the same contents published first, its copy is
+        // identical, so it is kept and this one dropped
+        if rename(stagingDirectory.path, output.deletingLastPathComponent().path) != 0 {
+            let error = errno
+            guard fileManager.fileExists(atPath: output.appendingPathComponent(mainPath).path) else {
+                NSLog("Error publishing patched \(bundleURL.lastPathComponent): \(String(cString: strerror(error)))")
+                return nil
+            }
+        }
+
+        NSLog("Patched \(entries.count) image(s) in \(bundleURL.lastPathComponent) in \(Int(manifest.milliseconds))ms")
+        return output.appendingPathComponent(mainPath)
+    }
+
+    // MARK: - Discovery
+
+    /// Every Mach-O file in the bundle, found once for both hashing and
+    /// patching. Symlinks are skipped so that the Versions/Current aliases of
+    /// a framework aren't patched twice.
+    private lazy var machOFiles: [(url: URL, size: Int)] = {
+        let keys: [URLResourceKey] = [.isRegularFileKey, .isSymbolicLinkKey, .fileSizeKey]
+        guard let enumerator = FileManager.default.enumerator(at: bundleURL, includingPropertiesForKeys: keys) else {
+            return []
+        }
+
+        var files: [(url: URL, size: Int)] = []
+
+        for case let url as URL in enumerator {
+            guard let values = try? url.resourceValues(forKeys: Set(keys)),
+                  values.isRegularFile == true, values.isSymbolicLink != true,
+                  let size = values.fileSize, size >= MemoryLayout<mach_header_64>.size,
+                  Self.isMachO(at: url.path) else { continue }
+            files.append((url, size))
+        }
+
+        return files
+    }()
+
+    /// Every loadable Mach-O in the bundle.
+    private func discoverImages() -> [Image] {
+        machOFiles.compactMap { file in
+            do {
+                return try readImage(at: file.url, size: file.size)
+            } catch {
+                NSLog("Skipping \(file.url.lastPathComponent): \(error)")
+                return nil
+            }
+        }
+    }
+
+    private func readImage(at url: URL, size: Int) throws -> Image? {
+        let file = try MappedFile(path: url.path, writable: false)
+        guard let slice = try file.preferredARM64Slice(),
+              let kind = MachOImageKind(filetype: slice.header.pointee.filetype) else { return nil }
+
+        var installNames: [String] = []
+        var rpaths: [String] = []
+
+        slice.forEachLoadCommand { command, _ in
+            let cmd = command.pointee.cmd
+            if MachOLoadCommand.dylibLoads.contains(cmd), let name = slice.dylibName(command) {
+                installNames.append(name)
+            } else if cmd == MachOLoadCommand.rpath, let path = slice.dylibName(command) {
+                rpaths.append(path)
+            }
+            return true
+        }
+
+        return Image(relativePath: relativePath(of: url), kind: kind, size: size, installNames: installNames, rpaths: rpaths)
+    }
+
+    /// Cheap magic check so resources aren't mapped just to be rejected. Java
+    /// class files share 0xcafebabe with fat headers, but never have a small
+    /// architecture count in the next word.
+    static func isMachO(at path: String) -> Bool {
+        let fd = open(path, O_RDONLY)
+        guard fd >= 0 else { return false }
+        defer { close(fd) }
+
+        var words: (UInt32, UInt32) = (0, 0)
+        guard pread(fd, &words, MemoryLayout.size(ofValue: words), 0) == MemoryLayout.size(ofValue: words) else { return false }
+
+        switch words.0 {
+        case MH_MAGIC_64:
+            return true
+        case FAT_CIGAM, FAT_CIGAM_64:
+            let architectures = words.1.byteSwapped
+            return architectures > 0 && architectures < 16
+        default:
+            return false
+        }
+    }
+
+    // MARK: - Dependency graph
+
+    private func resolveDependencies(of images: [Image], mainPath: String) -> [Manifest.Entry] {
+        var index: [String: String] = [:]
+        for image in images {
+            index[canonicalPath(bundleURL.appendingPathComponent(image.relativePath))] = image.relativePath
+        }
+
+        let mainDirectory = bundleURL.appendingPathComponent(mainPath).deletingLastPathComponent()
+        let mainRpaths = images.first { $0.relativePath == mainPath }?.rpaths ?? []
+
+        return images.map { image in
+            let loaderDirectory = bundleURL.appendingPathComponent(image.relativePath).deletingLastPathComponent()
+            // dyld searches the loader's own LC_RPATHs, then the main executable's
+            let rpaths = (image.rpaths + (image.relativePath == mainPath ? [] : mainRpaths)).map {
+                expand($0, executable: mainDirectory, loader: loaderDirectory)
+            }
+
+            var dependencies: [String] = []
+            var external: [String] = []
+
+            for name in image.installNames {
+                let candidates: [String]
+                if name.hasPrefix("@rpath/") {
+                    let rest = name.dropFirst("@rpath/".count)
+                    candidates = rpaths.map { $0 + "/" + rest }
+                } else {
+                    candidates = [expand(name, executable: mainDirectory, loader: loaderDirectory)]
+                }
+
+                if let match = candidates.lazy.compactMap({ index[self.canonicalPath(URL(fileURLWithPath: $0))] }).first {
+                    if match != image.relativePath, !dependencies.contains(match) {
+                        dependencies.append(match)
+                    }
+                } else {
+                    external.append(name)
+                }
+            }
+
+            return Manifest.Entry(path: image.relativePath, kind: image.kind, size: image.size, dependencies: dependencies, external: external, patched: false, milliseconds: 0)
+        }
+    }
+
+    private func expand(_ path: String, executable: URL, loader: URL) -> String {
+        if path.hasPrefix("@executable_path/") {
+            return executable.path + "/" + path.dropFirst("@executable_path/".count)
+        }
+        if path.hasPrefix("@loader_path/") {
+            return loader.path + "/" + path.dropFirst("@loader_path/".count)
+        }
+        return path
+    }
+
+    private func canonicalPath(_ url: URL) -> String {
+        url.resolvingSymlinksInPath().standardizedFileURL.path
+    }
+
+    private func relativePath(of url: URL) -> String {
+        let root = canonicalPath(bundleURL) + "/"
+        let path = canonicalPath(url)
+        return path.hasPrefix(root) ? String(path.dropFirst(root.count)) : url.lastPathComponent
+    }
+
+    /// `path` as seen from `directory`, both relative to the bundle root and
+    /// either possibly containing `..`.
+    private static func path(of path: String, from directory: String) -> String {
+        func components(_ path: String) -> [String] {
+            var result: [String] = []
+            for component in path.split(separator: "/") where component != "." {
+                if component == "..", let last = result.last, last != ".." {
+                    result.removeLast()
+                } else {
+                    result.append(String(component))
+                }
+            }
+            return result
+        }
+
+        let target = components(path)
+        let base = components(directory)
+        let common = zip(target, base).prefix { $0 == $1 }.count
+        return (Array(repeating: "..", count: base.count - common) + target.dropFirst(common)).joined(separator: "/")
+    }
+
+    /// Kahn's algorithm over the dependency edges. Anything left in a cycle is
+    /// appended in discovery order, since dyld copes with those itself.
+    /// Entries sharing a path (two images outside the bundle root both fall
+    /// back to their file name) are merged rather than trapping.
+    static func loadOrder(of entries: [Manifest.Entry]) -> [String] {
+        var remaining = Dictionary(entries.map { ($0.path, Set($0.dependencies)) }, uniquingKeysWith: { $0.union($1) })
+        var dependents: [String: [String]] = [:]
+        for entry in entries {
+            for dependency in entry.dependencies {
+                dependents[dependency, default: []].append(entry.path)
+            }
+        }
+
+        var seen = Set<String>()
+        let paths = entries.map(\.path).filter { seen.insert($0).inserted }
+        var ready = paths.filter { remaining[$0]?.isEmpty == true }
+        var order: [String] = []
+
+        while let path = ready.popLast() {
+            order.append(path)
+            remaining[path] = nil
+
+            for dependent in dependents[path] ?? [] {
+                remaining[dependent]?.remove(path)
+                if remaining[dependent]?.isEmpty == true {
+                    ready.append(dependent)
+                }
+            }
+        }
+
+        order += paths.filter { remaining[$0] != nil }
+        return order
+    }
+
+    // MARK: - Patching
+
+    /// The first pass rewrites each image on its own, which never reads another
+    /// image, so `concurrentPerform` hands images to whichever worker is free,
+    /// largest first so one huge framework isn't the last thing left running.
+    ///
+    /// Stubbing missing symbols does read the libraries an image links, so it
+    /// runs (with signing, which has to follow it) as a second pass in load
+    /// order, once no image in the bundle is being copied or resized any more.
+    private func patchImages(_ images: [Image], into entries: inout [Manifest.Entry], mainPath: String, staging: URL) {
+        let order = images.indices.sorted { images[$0].size > images[$1].size }
+        let executableDirectory = (mainPath as NSString).deletingLastPathComponent
+        let lock = NSLock()
+        var results = [(patched: Bool, milliseconds: Double)](repeating: (false, 0), count: images.count)
+        var patchers = [MachOPatcher?](repeating: nil, count: images.count)
+
+        DispatchQueue.concurrentPerform(iterations: order.count) { i in
+            let image = images[order[i]]
+            let start = DispatchTime.now()
+
+            // Once loaded into maciOS, @executable_path means maciOS itself, so it
+            // becomes the same place seen from the image's own directory. Nothing
+            // absolute is baked in, so the copy keeps working if the container moves.
+            let loaderDirectory = (image.relativePath as NSString).deletingLastPathComponent
+            let remaps: [(String, String)] = (image.installNames + image.rpaths)
+                .filter { $0.hasPrefix("@executable_path/") }
+                .map { path in
+                    let target = executableDirectory + "/" + path.dropFirst("@executable_path/".count)
+                    let relative = Self.path(of: target, from: loaderDirectory)
+                    return (path, relative.isEmpty ? "@loader_path" : "@loader_path/" + relative)
+                }
+
+            let patcher = MachOPatcher(bundleURL.appendingPathComponent(image.relativePath), patchedURL: staging.appendingPathComponent(image.relativePath))
+            patcher.appName = appName
+            let patched = patcher.patch(as: image.kind, additionalRemaps: remaps, finishing: false)
+            let milliseconds = Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000
+
+            lock.lock()
+            results[order[i]] = (patched, milliseconds)
+            patchers[order[i]] = patcher
+            lock.unlock()
+        }
+
+        let indices = Dictionary(images.indices.map { (images[$0].relativePath, $0) }, uniquingKeysWith: { first, _ in first })
+        for path in Self.loadOrder(of: entries) {
+            guard let i = indices[path], results[i].patched, let patcher = patchers[i] else { continue }
+
+            let start = DispatchTime.now()
+            results[i].patched = patcher.finishPatch()
+            results[i].milliseconds += Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000
+        }
+
+        for (i, result) in results.enumerated() {
+            entries[i].patched = result.patched
+            entries[i].milliseconds = result.milliseconds
+        }
+    }
+}
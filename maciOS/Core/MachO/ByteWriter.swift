@@ -0,0 +1,87 @@
+//
+//  ByteWriter.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Foundation
+
+/// Little-endian byte builder for Mach-O images written from scratch.
+struct ByteWriter {
+    var bytes: [UInt8] = []
+
+    var count: Int { bytes.count }
+
+    mutating func u8(_ value: UInt8) { bytes.append(value) }
+    mutating func u16(_ value: UInt16) { withUnsafeBytes(of: value.littleEndian) { bytes += $0 } }
+    mutating func u32(_ value: UInt32) { withUnsafeBytes(of: value.littleEndian) { bytes += $0 } }
+    mutating func u64(_ value: UInt64) { withUnsafeBytes(of: value.littleEndian) { bytes += $0 } }
+
+    mutating func uleb(_ value: UInt64) {
+        var value = value
+        repeat {
+            var byte = UInt8(value & 0x7f)
+            value >>= 7
+            if value != 0 { byte |= 0x80 }
+            bytes.append(byte)
+        } while value != 0
+    }
+
+    mutating func sleb(_ value: Int64) {
+        var value = value
+        while true {
+            let byte = UInt8(value & 0x7f)
+            value >>= 7
+            if (value == 0 && byte & 0x40 == 0) || (value == -1 && byte & 0x40 != 0) {
+                bytes.append(byte)
+                return
+            }
+            bytes.append(byte | 0x80)
+        }
+    }
+
+    mutating func cString(_ string: String) {
+        bytes += string.utf8
+        bytes.append(0)
+    }
+
+    mutating func align(_ alignment: Int) {
+        while bytes.count % alignment != 0 { bytes.append(0) }
+    }
+
+    /// A fixed `char[16]` name field.
+    mutating func name(_ string: String) {
+        let utf8 = Array(string.utf8.prefix(16))
+        bytes += utf8 + [UInt8](repeating: 0, count: 16 - utf8.count)
+    }
+
+    mutating func segment(_ name: String, vmaddr: UInt64, vmsize: UInt64, fileoff: UInt64, filesize: UInt64, prot: Int32, sections: Int) {
+        u32(MachOLoadCommand.segment64)
+        u32(UInt32(72 + sections * 80))
+        self.name(name)
+        u64(vmaddr)
+        u64(vmsize)
+        u64(fileoff)
+        u64(filesize)
+        u32(UInt32(bitPattern: prot))
+        u32(UInt32(bitPattern: prot))
+        u32(UInt32(sections))
+        u32(0)
+    }
+
+    mutating func section(_ name: String, _ segment: String, addr: UInt64, size: Int, offset: Int, align: UInt32, flags: UInt32) {
+        self.name(name)
+        self.name(segment)
+        u64(addr)
+        u64(UInt64(size))
+        u32(UInt32(offset))
+        u32(align)
+        u32(0) // reloff
+        u32(0) // nreloc
+        u32(flags)
+        for _ in 0..<3 {
+            u32(0)
+        }
+    }
+}
@@ -0,0 +1,325 @@
+//
+//  ChainedFixups.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Reader and writer for the imports table of LC_DYLD_CHAINED_FIXUPS.
+///
+/// The pointer chains in the data pages only refer to imports by index, so an
+/// import can be pointed at another library by rewriting its table entry alone.
+/// Retargets that fit the existing entry are written in place. Adding imports
+/// rebuilds the imports table and symbol pool, either over the old blob when it
+/// fits or appended to the end of __LINKEDIT.
+struct ChainedFixups {
+    /// `imports_format` values from <mach-o/fixup-chains.h>.
+    enum ImportFormat: UInt32 {
+        case plain = 1
+        case addend = 2
+        case addend64 = 3
+
+        var entrySize: Int {
+            switch self {
+            case .plain: return 4
+            case .addend: return 8
+            case .addend64: return 16
+            }
+        }
+    }
+
+    /// Special library ordinals.
+    static let selfOrdinal = 0
+    static let mainExecutableOrdinal = -1
+    static let flatLookupOrdinal = -2
+    static let weakLookupOrdinal = -3
+
+    struct Import: Equatable {
+        var libraryOrdinal: Int
+        var weak: Bool
+        var name: String
+        var addend: Int64
+    }
+
+    private enum Header {
+        static let size = 28
+        static let startsOffset = 4
+        static let importsOffset = 8
+        static let symbolsOffset = 12
+        static let importsCount = 16
+        static let importsFormat = 20
+        static let symbolsFormat = 24
+    }
+
+    private(set) var slice: MachOSlice
+    private(set) var imports: [Import]
+    /// Install names by ordinal - 1.
+    private(set) var libraries: [String]
+    private(set) var format: ImportFormat
+
+    private var commandOffset: Int
+    private var needsRebuild = false
+
+    private var command: UnsafeMutablePointer<linkedit_data_command> {
+        slice.base.advanced(by: commandOffset).assumingMemoryBound(to: linkedit_data_command.self)
+    }
+
+    private var blob: UnsafeMutableRawPointer {
+        slice.base.advanced(by: Int(command.pointee.dataoff))
+    }
+
+    private static func commandOffset(in slice: MachOSlice) -> Int? {
+        var found: Int?
+        slice.forEachLoadCommand { command, offset in
+            if command.pointee.cmd == MachOLoadCommand.dyldChainedFixups {
+                found = offset
+                return false
+            }
+            return true
+        }
+        return found
+    }
+
+    /// Returns nil when the slice has no LC_DYLD_CHAINED_FIXUPS.
+    init?(_ slice: MachOSlice) throws {
+        guard let found = Self.commandOffset(in: slice) else { return nil }
+
+        self.slice = slice
+        self.commandOffset = found
+        self.libraries = slice.dylibLoadNames
+
+        let command = slice.base.advanced(by: found).assumingMemoryBound(to: linkedit_data_command.self)
+        let dataOffset = Int(command.pointee.dataoff)
+        let dataSize = Int(command.pointee.datasize)
+        guard dataSize >= Header.size, dataOffset + dataSize <= slice.size else {
+            throw MachOError("Chained fixups lie outside the image")
+        }
+
+        let blob = UnsafeRawPointer(slice.base.advanced(by: dataOffset))
+        let field = { (offset: Int) in Int(blob.loadUnaligned(fromByteOffset: offset, as: UInt32.self)) }
+
+        guard field(0) == 0 else {
+            throw MachOError("Unsupported chained fixups version \(field(0))")
+        }
+        guard let format = ImportFormat(rawValue: UInt32(field(Header.importsFormat))) else {
+            throw MachOError("Unsupported chained imports format \(field(Header.importsFormat))")
+        }
+        guard field(Header.symbolsFormat) == 0 else {
+            throw MachOError("Compressed chained fixup symbols are not supported")
+        }
+
+        let importsOffset = field(Header.importsOffset)
+        let symbolsOffset = field(Header.symbolsOffset)
+        let count = field(Header.importsCount)
+        guard importsOffset + count * format.entrySize <= dataSize, symbolsOffset <= dataSize else {
+            throw MachOError("Chained imports table is truncated")
+        }
+
+        self.format = format
+        self.imports = try (0..<count).map { i in
+            var entry = Self.decode(blob.advanced(by: importsOffset + i * format.entrySize), format)
+            let nameOffset = symbolsOffset + entry.nameOffset
+            guard nameOffset < dataSize else {
+                throw MachOError("Chained import \(i) has its name outside the symbol pool")
+            }
+
+            let pool = UnsafeRawBufferPointer(start: blob.advanced(by: nameOffset), count: dataSize - nameOffset)
+            entry.value.name = String(decoding: pool.prefix { $0 != 0 }, as: UTF8.self)
+            return entry.value
+        }
+    }
+
+    // MARK: - Queries
+
+    func library(of item: Import) -> String? {
+        libraries.indices.contains(item.libraryOrdinal - 1) ? libraries[item.libraryOrdinal - 1] : nil
+    }
+
+    func ordinal(ofLibrary path: String) -> Int? {
+        libraries.firstIndex(of: path).map { $0 + 1 }
+    }
+
+    // MARK: - Editing
+
+    /// Points import `index` at another library. Written through immediately
+    /// when the current table format can hold the ordinal.
+    mutating func retarget(_ index: Int, toLibrary ordinal: Int) {
+        imports[index].libraryOrdinal = ordinal
+
+        guard !needsRebuild, Self.fits(imports[index], nameOffset: 0, in: format) else {
+            needsRebuild = true
+            return
+        }
+
+        let importsOffset = Int(blob.loadUnaligned(fromByteOffset: Header.importsOffset, as: UInt32.self))
+        let entry = blob.advanced(by: importsOffset + index * format.entrySize)
+
+        switch format {
+        case .plain, .addend:
+            var raw = entry.loadUnaligned(as: UInt32.self)
+            raw = raw & ~0xff | UInt32(UInt8(truncatingIfNeeded: ordinal))
+            entry.storeBytes(of: raw, as: UInt32.self)
+        case .addend64:
+            var raw = entry.loadUnaligned(as: UInt64.self)
+            raw = raw & ~0xffff | UInt64(UInt16(truncatingIfNeeded: ordinal))
+            entry.storeBytes(of: raw, as: UInt64.self)
+        }
+    }
+
+    /// Retargets every import named `name` and returns how many there were.
+    @discardableResult
+    mutating func retarget(symbol name: String, toLibrary ordinal: Int) -> Int {
+        var count = 0
+        for index in imports.indices where imports[index].name == name {
+            retarget(index, toLibrary: ordinal)
+            count += 1
+        }
+        return count
+    }
+
+    /// Adds an import and returns its index. Takes effect on `write()`.
+    @discardableResult
+    mutating func addImport(_ name: String, libraryOrdinal: Int, weak: Bool = false, addend: Int64 = 0) -> Int {
+        imports.append(Import(libraryOrdinal: libraryOrdinal, weak: weak, name: name, addend: addend))
+        needsRebuild = true
+        return imports.count - 1
+    }
+
+    /// Returns the ordinal of `path`, adding a load command for it if the image
+    /// doesn't link it yet.
+    mutating func addLibrary(_ path: String, weak: Bool = false) throws -> Int {
+        if let ordinal = ordinal(ofLibrary: path) {
+            return ordinal
+        }
+
+        let cmd = weak ? MachOLoadCommand.loadWeakDylib : MachOLoadCommand.loadDylib
+        guard slice.appendLoadCommand(MachOSlice.dylibCommand(cmd, path: path)) else {
+            throw MachOError("No room to add a load command for \(path)")
+        }
+
+        // Making room may have dropped commands in front of ours
+        guard let offset = Self.commandOffset(in: slice) else {
+            throw MachOError("LC_DYLD_CHAINED_FIXUPS disappeared while adding \(path)")
+        }
+        commandOffset = offset
+
+        libraries.append(path)
+        return libraries.count
+    }
+
+    /// Rebuilds the imports table if imports were added or a retarget didn't
+    /// fit the current format. The symbol pool is deduplicated on the way.
+    mutating func write() throws {
+        guard needsRebuild else { return }
+
+        let oldSize = Int(command.pointee.datasize)
+        let importsOffset = Int(blob.loadUnaligned(fromByteOffset: Header.importsOffset, as: UInt32.self))
+        let startsOffset = Int(blob.loadUnaligned(fromByteOffset: Header.startsOffset, as: UInt32.self))
+        guard startsOffset < importsOffset else {
+            throw MachOError("Chained fixup starts don't precede the imports table")
+        }
+
+        var pool: [UInt8] = []
+        var poolOffsets: [String: Int] = [:]
+        let nameOffsets = imports.map { item -> Int in
+            if let offset = poolOffsets[item.name] { return offset }
+            let offset = pool.count
+            pool.append(contentsOf: item.name.utf8)
+            pool.append(0)
+            poolOffsets[item.name] = offset
+            return offset
+        }
+
+        var format = self.format
+        if zip(imports, nameOffsets).contains(where: { !Self.fits($0, nameOffset: $1, in: format) }) {
+            format = .addend64
+        }
+
+        let alignment = format == .addend64 ? 8 : 4
+        let newImportsOffset = (importsOffset + alignment - 1) & ~(alignment - 1)
+        let symbolsOffset = newImportsOffset + imports.count * format.entrySize
+        let size = (symbolsOffset + pool.count + 7) & ~7
+
+        var bytes = [UInt8](repeating: 0, count: size)
+        bytes.withUnsafeMutableBytes { raw in
+            raw.baseAddress!.copyMemory(from: blob, byteCount: importsOffset)
+            raw.storeBytes(of: UInt32(newImportsOffset), toByteOffset: Header.importsOffset, as: UInt32.self)
+            raw.storeBytes(of: UInt32(symbolsOffset), toByteOffset: Header.symbolsOffset, as: UInt32.self)
+            raw.storeBytes(of: UInt32(imports.count), toByteOffset: Header.importsCount, as: UInt32.self)
+            raw.storeBytes(of: format.rawValue, toByteOffset: Header.importsFormat, as: UInt32.self)
+
+            for (i, item) in imports.enumerated() {
+                Self.encode(item, nameOffset: nameOffsets[i], format, to: raw.baseAddress!.advanced(by: newImportsOffset + i * format.entrySize))
+            }
+            pool.withUnsafeBytes { raw.baseAddress!.advanced(by: symbolsOffset).copyMemory(from: $0.baseAddress!, byteCount: $0.count) }
+        }
+
+        if size <= oldSize {
+            memset(blob, 0, oldSize)
+            bytes.withUnsafeBytes { blob.copyMemory(from: $0.baseAddress!, byteCount: size) }
+        } else {
+            try append(bytes)
+        }
+
+        self.format = format
+        needsRebuild = false
+    }
+
+    /// Moves the blob to the end of the file, growing __LINKEDIT to cover it.
+    private mutating func append(_ bytes: [UInt8]) throws {
+        let appended = try slice.appendingToLinkedit(bytes)
+        slice = appended.slice
+        command.pointee.dataoff = UInt32(appended.offset)
+        command.pointee.datasize = UInt32(bytes.count)
+    }
+
+    // MARK: - Encoding
+
+    private static func decode(_ entry: UnsafeRawPointer, _ format: ImportFormat) -> (value: Import, nameOffset: Int) {
+        switch format {
+        case .plain, .addend:
+            let raw = entry.loadUnaligned(as: UInt32.self)
+            let addend = format == .addend ? Int64(entry.loadUnaligned(fromByteOffset: 4, as: Int32.self)) : 0
+            let ordinal = Int(raw & 0xff)
+            return (Import(libraryOrdinal: ordinal > 0xf0 ? Int(Int8(truncatingIfNeeded: ordinal)) : ordinal,
+                           weak: raw >> 8 & 1 != 0, name: "", addend: addend), Int(raw >> 9))
+        case .addend64:
+            let raw = entry.loadUnaligned(as: UInt64.self)
+            let ordinal = Int(raw & 0xffff)
+            return (Import(libraryOrdinal: ordinal > 0xfff0 ? Int(Int16(truncatingIfNeeded: ordinal)) : ordinal,
+                           weak: raw >> 16 & 1 != 0, name: "", addend: entry.loadUnaligned(fromByteOffset: 8, as: Int64.self)), Int(raw >> 32))
+        }
+    }
+
+    private static func encode(_ item: Import, nameOffset: Int, _ format: ImportFormat, to entry: UnsafeMutableRawPointer) {
+        let weak = item.weak ? 1 : 0
+
+        switch format {
+        case .plain, .addend:
+            let raw = UInt32(UInt8(truncatingIfNeeded: item.libraryOrdinal)) | UInt32(weak) << 8 | UInt32(nameOffset) << 9
+            entry.storeBytes(of: raw, as: UInt32.self)
+            if format == .addend {
+                entry.storeBytes(of: Int32(item.addend), toByteOffset: 4, as: Int32.self)
+            }
+        case .addend64:
+            let raw = UInt64(UInt16(truncatingIfNeeded: item.libraryOrdinal)) | UInt64(weak) << 16 | UInt64(nameOffset) << 32
+            entry.storeBytes(of: raw, as: UInt64.self)
+            entry.storeBytes(of: item.addend, toByteOffset: 8, as: Int64.self)
+        }
+    }
+
+    private static func fits(_ item: Import, nameOffset: Int, in format: ImportFormat) -> Bool {
+        switch format {
+        case .plain:
+            return (-3...0xf0).contains(item.libraryOrdinal) && item.addend == 0 && nameOffset < 1 << 23
+        case .addend:
+            return (-3...0xf0).contains(item.libraryOrdinal) && Int64(Int32.min)...Int64(Int32.max) ~= item.addend && nameOffset < 1 << 23
+        case .addend64:
+            return (-3...0xfff0).contains(item.libraryOrdinal) && nameOffset <= Int(UInt32.max)
+        }
+    }
+}
@@ -0,0 +1,236 @@
+//
+//  CodeSigner.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import CryptoKit
+import Darwin
+import Foundation
+import MachO
+
+/// Writes an ad-hoc signature (a CodeDirectory of SHA-256 page hashes, an
+/// empty requirement set and an empty CMS wrapper) over a patched thin image.
+/// The dyld validation hooks make a stale signature harmless, but paths that
+/// go through F_ADDFILESIGS_RETURN or TXM want one that actually matches.
+///
+/// Pages are hashed in chunks across every core with CryptoKit, which uses
+/// the SHA-256 instructions of the CPU.
+struct CodeSigner {
+    static let pageSizeDefaultsKey = "AdHocSignPageSize"
+
+    private static let superBlobMagic: UInt32 = 0xfade0cc0
+    private static let codeDirectoryMagic: UInt32 = 0xfade0c02
+    private static let requirementsMagic: UInt32 = 0xfade0c01
+    private static let blobWrapperMagic: UInt32 = 0xfade0b01
+
+    private static let codeDirectorySlot: UInt32 = 0
+    private static let requirementsSlot: UInt32 = 2
+    private static let signatureSlot: UInt32 = 0x10000
+
+    /// CodeDirectory version with the executable segment fields.
+    private static let codeDirectoryVersion: UInt32 = 0x20400
+    private static let codeDirectoryHeaderSize = 88
+    private static let adHocFlag: UInt32 = 0x2
+    private static let execSegMainBinary: UInt64 = 0x1
+    private static let hashTypeSHA256: UInt8 = 2
+    private static let hashSize = 32
+    /// Info.plist and requirements; the others are never present in a patched image.
+    private static let specialSlots = 2
+
+    let identifier: String
+    let pageSize: Int
+
+    /// `pageSize` must be 4 KB or 16 KB; defaults to `AdHocSignPageSize`, else 4 KB.
+    init(identifier: String, pageSize: Int? = nil) {
+        self.identifier = identifier
+
+        let configured = pageSize ?? UserDefaults.standard.integer(forKey: Self.pageSizeDefaultsKey)
+        self.pageSize = configured == 16384 ? 16384 : 4096
+    }
+
+    /// Replaces the signature of the thin image at `path`, or appends one to
+    /// the end of __LINKEDIT if it has none.
+    func sign(_ path: String) throws {
+        let file = try MappedFile(path: path)
+        guard !file.isUniversal, var slice = try file.preferredARM64Slice() else {
+            throw MachOError("Only thin arm64 images can be signed: \(path)")
+        }
+
+        if Self.signatureCommandOffset(in: slice) == nil {
+            let command = Self.signatureCommand()
+            try HeaderSpace(slice).reserve(command.count)
+            try HeaderSpace(slice).insert(command)
+        }
+
+        guard let commandOffset = Self.signatureCommandOffset(in: slice),
+              let linkedit = slice.segment(named: "__LINKEDIT"),
+              let text = slice.segment(named: "__TEXT") else {
+            throw MachOError("\(path) has no __TEXT or __LINKEDIT")
+        }
+
+        guard Int(linkedit.pointee.fileoff + linkedit.pointee.filesize) == file.size else {
+            throw MachOError("__LINKEDIT is not at the end of \(path)")
+        }
+
+        // Reuse the old signature's place when it is the last thing in the
+        // file; otherwise the new one goes after everything else.
+        let command = slice.base.advanced(by: commandOffset).assumingMemoryBound(to: linkedit_data_command.self)
+        let oldOffset = Int(command.pointee.dataoff)
+        let signatureOffset = oldOffset > 0 && oldOffset + Int(command.pointee.datasize) == file.size
+            ? oldOffset
+            : (file.size + 15) & ~15
+
+        let codeLimit = signatureOffset
+        let codeSlots = (codeLimit + pageSize - 1) / pageSize
+        let identifierBytes = Array(identifier.utf8) + [0]
+        let codeDirectorySize = Self.codeDirectoryHeaderSize + identifierBytes.count + (Self.specialSlots + codeSlots) * Self.hashSize
+        let requirements = Self.blob(Self.requirementsMagic, [0, 0, 0, 0])
+        let wrapper = Self.blob(Self.blobWrapperMagic, [])
+        let superBlobHeaderSize = 12 + 3 * 8
+        let signatureSize = (superBlobHeaderSize + codeDirectorySize + requirements.count + wrapper.count + 15) & ~15
+
+        guard signatureOffset + signatureSize <= Int(UInt32.max) else {
+            throw MachOError("\(path) is too large to sign")
+        }
+
+        // Everything the page hashes cover has to be final before hashing,
+        // including the load commands describing the signature itself.
+        command.pointee.dataoff = UInt32(signatureOffset)
+        command.pointee.datasize = UInt32(signatureSize)
+
+        linkedit.pointee.filesize = UInt64(signatureOffset + signatureSize) - linkedit.pointee.fileoff
+        let pageMask: UInt64 = 0x3fff
+        linkedit.pointee.vmsize = max(linkedit.pointee.vmsize, (linkedit.pointee.filesize + pageMask) & ~pageMask)
+
+        let execSegBase = text.pointee.fileoff
+        let execSegLimit = text.pointee.filesize
+        let isMainBinary = slice.header.pointee.filetype == UInt32(MH_EXECUTE)
+
+        try file.resize(to: signatureOffset + signatureSize)
+        slice = MachOSlice(file: file, offset: 0, size: file.size)
+
+        let pageHashes = hashPages(UnsafeRawPointer(slice.base), codeLimit: codeLimit)
+
+        var codeDirectory: [UInt8] = []
+        codeDirectory.reserveCapacity(codeDirectorySize)
+        let hashOffset = Self.codeDirectoryHeaderSize + identifierBytes.count + Self.specialSlots * Self.hashSize
+
+        Self.append(Self.codeDirectoryMagic, to: &codeDirectory)
+        Self.append(UInt32(codeDirectorySize), to: &codeDirectory)
+        Self.append(Self.codeDirectoryVersion, to: &codeDirectory)
+        Self.append(Self.adHocFlag, to: &codeDirectory)
+        Self.append(UInt32(hashOffset), to: &codeDirectory)
+        Self.append(UInt32(Self.codeDirectoryHeaderSize), to: &codeDirectory)
+        Self.append(UInt32(Self.specialSlots), to: &codeDirectory)
+        Self.append(UInt32(codeSlots), to: &codeDirectory)
+        Self.append(UInt32(codeLimit), to: &codeDirectory)
+        codeDirectory += [UInt8(Self.hashSize), Self.hashTypeSHA256, 0, UInt8(pageSize.trailingZeroBitCount)]
+        Self.append(UInt32(0), to: &codeDirectory) // spare2
+        Self.append(UInt32(0), to: &codeDirectory) // scatterOffset
+        Self.append(UInt32(0), to: &codeDirectory) // teamOffset
+        Self.append(UInt32(0), to: &codeDirectory) // spare3
+        Self.append(UInt64(0), to: &codeDirectory) // codeLimit64
+        Self.append(execSegBase, to: &codeDirectory)
+        Self.append(execSegLimit, to: &codeDirectory)
+        Self.append(isMainBinary ? Self.execSegMainBinary : 0, to: &codeDirectory)
+        codeDirectory += identifierBytes
+
+        // Special slots count down from the code hashes: -2 is the
+        // requirements blob, -1 the (absent) Info.plist.
+        codeDirectory += Array(SHA256.hash(data: requirements))
+        codeDirectory += [UInt8](repeating: 0, count: Self.hashSize)
+        codeDirectory += pageHashes
+
+        var signature: [UInt8] = []
+        signature.reserveCapacity(signatureSize)
+        let blobs = [(Self.codeDirectorySlot, codeDirectory), (Self.requirementsSlot, requirements), (Self.signatureSlot, wrapper)]
+
+        Self.append(Self.superBlobMagic, to: &signature)
+        Self.append(UInt32(signatureSize), to: &signature)
+        Self.append(UInt32(blobs.count), to: &signature)
+
+        var blobOffset = superBlobHeaderSize
+        for (slot, blob) in blobs {
+            Self.append(slot, to: &signature)
+            Self.append(UInt32(blobOffset), to: &signature)
+            blobOffset += blob.count
+        }
+        for (_, blob) in blobs {
+            signature += blob
+        }
+        signature += [UInt8](repeating: 0, count: signatureSize - signature.count)
+
+        signature.withUnsafeBytes { slice.base.advanced(by: signatureOffset).copyMemory(from: $0.baseAddress!, byteCount: $0.count) }
+        file.sync()
+    }
+
+    /// SHA-256 of every page below `codeLimit`, in order. The last page is
+    /// hashed short, as the kernel does.
+    private func hashPages(_ base: UnsafeRawPointer, codeLimit: Int) -> [UInt8] {
+        let pageCount = (codeLimit + pageSize - 1) / pageSize
+        var hashes = [UInt8](repeating: 0, count: pageCount * Self.hashSize)
+        guard pageCount > 0 else { return hashes }
+
+        // A few chunks per core keeps every core busy when pages fault in at
+        // different speeds, without paying dispatch overhead per page.
+        let chunkCount = min(pageCount, ProcessInfo.processInfo.activeProcessorCount * 4)
+        let pagesPerChunk = (pageCount + chunkCount - 1) / chunkCount
+        let pageSize = self.pageSize
+
+        madvise(UnsafeMutableRawPointer(mutating: base), codeLimit, MADV_WILLNEED)
+
+        hashes.withUnsafeMutableBytes { output in
+            let output = output.baseAddress!
+            DispatchQueue.concurrentPerform(iterations: chunkCount) { chunk in
+                let first = chunk * pagesPerChunk
+                let last = min(first + pagesPerChunk, pageCount)
+
+                for page in first..<max(first, last) {
+                    let start = page * pageSize
+                    let digest = SHA256.hash(bufferPointer: UnsafeRawBufferPointer(start: base + start, count: min(pageSize, codeLimit - start)))
+                    digest.withUnsafeBytes { output.advanced(by: page * Self.hashSize).copyMemory(from: $0.baseAddress!, byteCount: Self.hashSize) }
+                }
+            }
+        }
+
+        return hashes
+    }
+
+    // MARK: - Encoding
+
+    private static func signatureCommandOffset(in slice: MachOSlice) -> Int? {
+        var found: Int?
+        slice.forEachLoadCommand { command, offset in
+            if command.pointee.cmd == MachOLoadCommand.codeSignature {
+                found = offset
+                return false
+            }
+            return true
+        }
+        return found
+    }
+
+    /// An LC_CODE_SIGNATURE pointing nowhere yet; `sign` fills it in.
+    private static func signatureCommand() -> [UInt8] {
+        var bytes = [UInt8](repeating: 0, count: MemoryLayout<linkedit_data_command>.size)
+        bytes.withUnsafeMutableBytes { buffer in
+            buffer.storeBytes(of: MachOLoadCommand.codeSignature, as: UInt32.self)
+            buffer.storeBytes(of: UInt32(buffer.count), toByteOffset: 4, as: UInt32.self)
+        }
+        return bytes
+    }
+
+    /// A generic blob: big endian magic and length, then the payload.
+    private static func blob(_ magic: UInt32, _ payload: [UInt8]) -> [UInt8] {
+        var bytes: [UInt8] = []
+        append(magic, to: &bytes)
+        append(UInt32(8 + payload.count), to: &bytes)
+        return bytes + payload
+    }
+
+    private static func append<T: FixedWidthInteger>(_ value: T, to bytes: inout [UInt8]) {
+        withUnsafeBytes(of: value.bigEndian) { bytes.append(contentsOf: $0) }
+    }
+}
@@ -0,0 +1,351 @@
+//
+//  DependencyAnalyzer.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Walks the dependency closure of a guest image the way dyld will once it is
+/// dlopen'ed from maciOS, and reports every library and symbol that won't
+/// resolve, instead of dlopen failing on the first one.
+///
+/// Libraries are resolved from the image's own LC_RPATHs, those of the images
+/// that loaded it, then the app's Frameworks directory, which is where the
+/// replacements in Core/Dependencies end up. Imports are checked against the
+/// export trie of whichever file their ordinal resolves to, following
+/// re-exports. Parsed images and their export indexes are shared by every
+/// analysis in the process, so a second analysis mostly costs hash lookups.
+struct DependencyAnalyzer {
+    struct MissingLibrary: Hashable {
+        let path: String
+        let requiredBy: String
+    }
+
+    struct MissingSymbol: Hashable {
+        let name: String
+        let library: String
+        let requiredBy: String
+    }
+
+    struct Report {
+        /// Every file in the closure, root first.
+        var images: [String] = []
+        var missingLibraries: [MissingLibrary] = []
+        var missingSymbols: [MissingSymbol] = []
+        /// Imports that couldn't be checked: flat lookups, and symbols of
+        /// shared cache libraries that aren't loaded yet.
+        var uncheckedSymbols = 0
+        var milliseconds: Double = 0
+
+        var isLoadable: Bool {
+            missingLibraries.isEmpty && missingSymbols.isEmpty
+        }
+
+        var summary: String {
+            var lines = ["\(images.count) images, \(missingLibraries.count) missing libraries, \(missingSymbols.count) missing symbols, \(uncheckedSymbols) unchecked (\(String(format: "%.1f", milliseconds)) ms)"]
+            lines += missingLibraries.map { "missing library \($0.path) (needed by \(($0.requiredBy as NSString).lastPathComponent))" }
+            lines += missingSymbols.map { "missing symbol \($0.name) in \(($0.library as NSString).lastPathComponent) (needed by \(($0.requiredBy as NSString).lastPathComponent))" }
+            return lines.joined(separator: "\n")
+        }
+    }
+
+    private enum Resolution {
+        case file(String)
+        case sharedCache(String)
+        case missing
+    }
+
+    private struct Dependency {
+        let name: String
+        let weak: Bool
+        let reexport: Bool
+    }
+
+    private struct Import {
+        let name: String
+        let libraryOrdinal: Int
+        let weak: Bool
+    }
+
+    /// The load commands of one file, memoized by path until the file changes.
+    private final class Image {
+        let path: String
+        let stamp: FileStamp
+        let dependencies: [Dependency]
+        let rpaths: [String]
+        /// Built on first symbol lookup, under the analyzer lock.
+        var exports: ExportIndex??
+        var reexports: [Resolution]?
+
+        init(path: String, stamp: FileStamp, dependencies: [Dependency], rpaths: [String]) {
+            self.path = path
+            self.stamp = stamp
+            self.dependencies = dependencies
+            self.rpaths = rpaths
+        }
+    }
+
+    private static let lock = NSLock()
+    private static var images: [String: Image] = [:]
+    private static var sharedCacheHandles: [String: UnsafeMutableRawPointer?] = [:]
+
+    /// Applied to install names before resolving them, for analysing an
+    /// input before it has been patched. Nil for images that already were.
+    let rules: FrameworkRemapRules?
+
+    init(rules: FrameworkRemapRules? = nil) {
+        self.rules = rules
+    }
+
+    func analyze(_ url: URL) -> Report {
+        let start = DispatchTime.now()
+        var report = Report()
+
+        let root = Self.canonicalPath(url.path)
+        var queue: [(path: String, requiredBy: String, inheritedRpaths: [String])] = [(root, root, [])]
+        var visited: Set<String> = [root]
+        var head = 0
+
+        while head < queue.count {
+            let (path, requiredBy, inheritedRpaths) = queue[head]
+            head += 1
+
+            guard let image = Self.image(at: path) else {
+                report.missingLibraries.append(MissingLibrary(path: path, requiredBy: requiredBy))
+                continue
+            }
+            report.images.append(path)
+
+            let loaderDirectory = (path as NSString).deletingLastPathComponent
+            let rpaths = image.rpaths.map { Self.expand($0, loader: loaderDirectory) } + inheritedRpaths
+
+            var ordinals: [Resolution] = []
+            for dependency in image.dependencies {
+                let name = rules?.replacement(for: dependency.name) ?? dependency.name
+                let resolution = Self.resolve(name, rpaths: rpaths + Self.hostRpaths, loaderDirectory: loaderDirectory)
+                ordinals.append(resolution)
+
+                switch resolution {
+                case .file(let dependencyPath):
+                    if visited.insert(dependencyPath).inserted {
+                        queue.append((dependencyPath, path, rpaths))
+                    }
+                case .sharedCache:
+                    break
+                case .missing:
+                    if !dependency.weak {
+                        report.missingLibraries.append(MissingLibrary(path: name, requiredBy: path))
+                    }
+                }
+            }
+
+            // The replacements shipped with the app are known to bind
+            guard !path.hasPrefix(Self.appBundlePath) else { continue }
+
+            for item in Self.imports(of: path) where !item.weak {
+                guard ordinals.indices.contains(item.libraryOrdinal - 1) else {
+                    report.uncheckedSymbols += 1
+                    continue
+                }
+
+                switch Self.lookup(item.name, in: ordinals[item.libraryOrdinal - 1]) {
+                case true?:
+                    break
+                case false?:
+                    if case .file(let library) = ordinals[item.libraryOrdinal - 1] {
+                        report.missingSymbols.append(MissingSymbol(name: item.name, library: library, requiredBy: path))
+                    }
+                case nil:
+                    report.uncheckedSymbols += 1
+                }
+            }
+        }
+
+        report.milliseconds = Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000
+        return report
+    }
+
+    // MARK: - Resolution
+
+    private static let appBundlePath = canonicalPath(Bundle.main.bundlePath)
+
+    /// maciOS's own LC_RPATH, which every guest inherits.
+    private static let hostRpaths = [Bundle.main.privateFrameworksPath ?? Bundle.main.bundlePath + "/Frameworks"]
+
+    private static func resolve(_ name: String, rpaths: [String], loaderDirectory: String) -> Resolution {
+        if name.hasPrefix("/"), _dyld_shared_cache_contains_path(name) {
+            return .sharedCache(name)
+        }
+
+        let candidates: [String]
+        if name.hasPrefix("@rpath/") {
+            let rest = name.dropFirst("@rpath/".count)
+            candidates = rpaths.map { $0 + "/" + rest }
+        } else {
+            candidates = [expand(name, loader: loaderDirectory)]
+        }
+
+        for candidate in candidates where access(candidate, F_OK) == 0 {
+            return .file(canonicalPath(candidate))
+        }
+        return .missing
+    }
+
+    /// @executable_path is maciOS itself once the guest is loaded.
+    private static func expand(_ path: String, loader: String) -> String {
+        if path.hasPrefix("@executable_path/") {
+            return (Bundle.main.executablePath.map { ($0 as NSString).deletingLastPathComponent } ?? Bundle.main.bundlePath) + "/" + path.dropFirst("@executable_path/".count)
+        }
+        if path.hasPrefix("@loader_path/") {
+            return loader + "/" + path.dropFirst("@loader_path/".count)
+        }
+        return path
+    }
+
+    private static func canonicalPath(_ path: String) -> String {
+        URL(fileURLWithPath: path).resolvingSymlinksInPath().standardizedFileURL.path
+    }
+
+    /// Whether `name` is exported by `library`: true or false when that can be
+    /// told from its exports, nil when it can't.
+    private static func lookup(_ name: String, in library: Resolution, depth: Int = 0) -> Bool? {
+        switch library {
+        case .missing:
+            return nil
+
+        case .sharedCache(let path):
+            // Only libraries that are already loaded are asked; loading one
+            // here would run its initializers before the guest does.
+            guard name.hasPrefix("_"), let handle = sharedCacheHandle(for: path) else { return nil }
+            return dlsym(handle, String(name.dropFirst())) != nil
+
+        case .file(let path):
+            guard let image = image(at: path), let exports = exports(of: image) else { return nil }
+            if exports.contains(name) { return true }
+
+            guard depth < 8 else { return false }
+            var unknown = false
+            for reexport in reexports(of: image) {
+                switch lookup(name, in: reexport, depth: depth + 1) {
+                case true?: return true
+                case nil: unknown = true
+                case false?: break
+                }
+            }
+            return unknown ? nil : false
+        }
+    }
+
+    private static func exports(of image: Image) -> ExportIndex? {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if let exports = image.exports {
+            return exports
+        }
+        let exports = try? ExportIndex.cached(for: image.path)
+        image.exports = .some(exports)
+        return exports
+    }
+
+    private static func reexports(of image: Image) -> [Resolution] {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if let reexports = image.reexports {
+            return reexports
+        }
+
+        let loaderDirectory = (image.path as NSString).deletingLastPathComponent
+        let rpaths = image.rpaths.map { expand($0, loader: loaderDirectory) } + hostRpaths
+        let reexports = image.dependencies.filter(\.reexport).map { resolve($0.name, rpaths: rpaths, loaderDirectory: loaderDirectory) }
+        image.reexports = reexports
+        return reexports
+    }
+
+    private static func sharedCacheHandle(for path: String) -> UnsafeMutableRawPointer? {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if let handle = sharedCacheHandles[path] {
+            return handle
+        }
+        let handle = dlopen(path, RTLD_NOLOAD | RTLD_LAZY)
+        if handle != nil {
+            sharedCacheHandles[path] = handle
+        }
+        return handle
+    }
+
+    // MARK: - Reading images
+
+    private static func image(at path: String) -> Image? {
+        guard let stamp = FileStamp(path: path) else { return nil }
+
+        lock.lock()
+        if let image = images[path], image.stamp == stamp {
+            lock.unlock()
+            return image
+        }
+        lock.unlock()
+
+        guard let file = try? MappedFile(path: path, writable: false),
+              let slice = try? file.preferredARM64Slice() else {
+            return nil
+        }
+
+        var dependencies: [Dependency] = []
+        var rpaths: [String] = []
+
+        slice.forEachLoadCommand { command, _ in
+            let cmd = command.pointee.cmd
+            if MachOLoadCommand.dylibLoads.contains(cmd), let name = slice.dylibName(command) {
+                dependencies.append(Dependency(name: name, weak: cmd == MachOLoadCommand.loadWeakDylib, reexport: cmd == MachOLoadCommand.reexportDylib))
+            } else if cmd == MachOLoadCommand.rpath, let path = slice.dylibName(command) {
+                rpaths.append(path)
+            }
+            return true
+        }
+
+        let image = Image(path: path, stamp: stamp, dependencies: dependencies, rpaths: rpaths)
+
+        lock.lock()
+        defer { lock.unlock() }
+        if let existing = images[path], existing.stamp == stamp {
+            return existing
+        }
+        images[path] = image
+        return image
+    }
+
+    /// Non-lazy and lazy imports alike, from the chained fixups or bind opcodes
+    /// when the image has them and from the undefined symbols otherwise.
+    private static func imports(of path: String) -> [Import] {
+        guard let file = try? MappedFile(path: path, writable: false),
+              let slice = try? file.preferredARM64Slice() else {
+            return []
+        }
+
+        if let fixups = try? ChainedFixups(slice) {
+            return fixups.imports.map { Import(name: $0.name, libraryOrdinal: $0.libraryOrdinal, weak: $0.weak) }
+        }
+
+        if let binds = try? DyldInfoBinds(slice) {
+            // One bind per pointer, so a symbol usually appears many times
+            var seen = Set<String>()
+            return (binds.binds + binds.lazyBinds.map(\.bind))
+                .filter { seen.insert("\($0.libraryOrdinal) \($0.name)").inserted }
+                .map { Import(name: $0.name, libraryOrdinal: $0.libraryOrdinal, weak: $0.isWeakImport) }
+        }
+
+        return slice.undefinedSymbols().map { symbol in
+            // GET_LIBRARY_ORDINAL; 0xfe and 0xff are flat and main executable lookups
+            let ordinal = Int(symbol.desc >> 8 & 0xff)
+            return Import(name: symbol.name, libraryOrdinal: ordinal >= 0xfe ? ordinal - 0x100 : ordinal, weak: Int32(symbol.desc) & N_WEAK_REF != 0)
+        }
+    }
+}
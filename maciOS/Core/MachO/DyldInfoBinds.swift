@@ -0,0 +1,679 @@
+//
+//  DyldInfoBinds.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Reader and writer for the bind opcode streams of LC_DYLD_INFO(_ONLY), the
+/// import format of images built before chained fixups.
+///
+/// `forEachBind` interprets a stream in place and hands out each bind with its
+/// symbol still pointing into the mapped file, so walking even a large image
+/// allocates nothing. Editing works like `ChainedFixups`: the bind stream is
+/// re-encoded compactly on `write()`, over the old one when it fits and at the
+/// end of __LINKEDIT otherwise. Lazy binds are edited in place instead, since
+/// `__stub_helper` refers to each entry by its offset in the lazy stream; when
+/// a new ordinal doesn't fit the old opcode, the whole lazy stream is rebuilt
+/// at the end of __LINKEDIT and `__stub_helper` re-pointed at it.
+/// The weak bind stream has no ordinals and is only read.
+struct DyldInfoBinds {
+    enum Stream {
+        case bind
+        case weakBind
+        case lazyBind
+    }
+
+    /// One bind as the opcodes leave it. `symbol` points into the stream.
+    struct RawBind {
+        var segmentIndex = 0
+        var segmentOffset: UInt64 = 0
+        var libraryOrdinal = 0
+        var symbol: UnsafePointer<CChar>?
+        var flags: UInt8 = 0
+        var type: UInt8 = 0
+        var addend: Int64 = 0
+        /// Stream offsets of the opcodes that set the ordinal and the symbol.
+        var ordinalOpcode: Int?
+        var symbolOpcode = 0
+        /// Stream offset of the lazy entry the bind belongs to, which is what
+        /// `__stub_helper` passes to dyld.
+        var entryOffset = 0
+    }
+
+    typealias LazyBind = (bind: Bind, ordinalOpcode: Int?, symbolOpcode: Int, entryOffset: Int)
+
+    struct Bind: Equatable {
+        var libraryOrdinal: Int
+        var name: String
+        var flags: UInt8
+        var type: UInt8
+        var addend: Int64
+        var segmentIndex: Int
+        var segmentOffset: UInt64
+
+        var isWeakImport: Bool {
+            flags & Flag.weakImport != 0
+        }
+    }
+
+    private enum Opcode {
+        static let done: UInt8 = 0x00
+        static let setDylibOrdinalImm: UInt8 = 0x10
+        static let setDylibOrdinalUleb: UInt8 = 0x20
+        static let setDylibSpecialImm: UInt8 = 0x30
+        static let setSymbolTrailingFlagsImm: UInt8 = 0x40
+        static let setTypeImm: UInt8 = 0x50
+        static let setAddendSleb: UInt8 = 0x60
+        static let setSegmentAndOffsetUleb: UInt8 = 0x70
+        static let addAddrUleb: UInt8 = 0x80
+        static let doBind: UInt8 = 0x90
+        static let doBindAddAddrUleb: UInt8 = 0xa0
+        static let doBindAddAddrImmScaled: UInt8 = 0xb0
+        static let doBindUlebTimesSkippingUleb: UInt8 = 0xc0
+        static let threaded: UInt8 = 0xd0
+    }
+
+    private enum Flag {
+        static let weakImport: UInt8 = 0x1
+    }
+
+    private static let pointerSize: UInt64 = 8
+
+    /// `ldr w16, #8`, the first instruction of every arm64 `__stub_helper` entry.
+    private static let stubHelperLoad: UInt32 = 0x18000050
+
+    private(set) var slice: MachOSlice
+    /// The bind stream, decoded; `write()` encodes it again.
+    private(set) var binds: [Bind]
+    private(set) var weakBinds: [Bind]
+    /// Lazy binds, with the stream offsets their in-place edits need.
+    private(set) var lazyBinds: [LazyBind]
+    /// Install names by ordinal - 1.
+    private(set) var libraries: [String]
+
+    private var commandOffset: Int
+    private var needsRebuild = false
+    private var needsLazyRebuild = false
+
+    private var command: UnsafeMutablePointer<dyld_info_command> {
+        slice.base.advanced(by: commandOffset).assumingMemoryBound(to: dyld_info_command.self)
+    }
+
+    private static func commandOffset(in slice: MachOSlice) -> Int? {
+        var found: Int?
+        slice.forEachLoadCommand { command, offset in
+            if command.pointee.cmd == MachOLoadCommand.dyldInfo || command.pointee.cmd == MachOLoadCommand.dyldInfoOnly {
+                found = offset
+                return false
+            }
+            return true
+        }
+        return found
+    }
+
+    /// Returns nil when the slice has no LC_DYLD_INFO(_ONLY).
+    init?(_ slice: MachOSlice) throws {
+        guard let found = Self.commandOffset(in: slice) else { return nil }
+
+        self.slice = slice
+        self.commandOffset = found
+        self.libraries = slice.dylibLoadNames
+
+        var binds: [Bind] = []
+        var weakBinds: [Bind] = []
+        var lazyBinds: [LazyBind] = []
+
+        try Self.forEachBind(.bind, in: slice) { binds.append(Self.bind($0)) }
+        try Self.forEachBind(.weakBind, in: slice) { weakBinds.append(Self.bind($0)) }
+        try Self.forEachBind(.lazyBind, in: slice) { lazyBinds.append((Self.bind($0), $0.ordinalOpcode, $0.symbolOpcode, $0.entryOffset)) }
+
+        self.binds = binds
+        self.weakBinds = weakBinds
+        self.lazyBinds = lazyBinds
+    }
+
+    // MARK: - Queries
+
+    func ordinal(ofLibrary path: String) -> Int? {
+        libraries.firstIndex(of: path).map { $0 + 1 }
+    }
+
+    /// Every symbol bound through the bind and lazy bind streams.
+    var importedSymbols: Set<String> {
+        Set(binds.map(\.name) + lazyBinds.map(\.bind.name))
+    }
+
+    /// Number of binds in every stream of `slice`, without decoding a name;
+    /// 0 when it has no LC_DYLD_INFO(_ONLY).
+    static func count(in slice: MachOSlice) throws -> Int {
+        var count = 0
+        for stream in [Stream.bind, .weakBind, .lazyBind] {
+            try forEachBind(stream, in: slice) { _ in count += 1 }
+        }
+        return count
+    }
+
+    // MARK: - Interpreter
+
+    /// Calls `body` with each bind of `stream` in the order the opcodes
+    /// produce them. Nothing is allocated unless the stream is malformed.
+    static func forEachBind(_ stream: Stream, in slice: MachOSlice, _ body: (RawBind) throws -> Void) throws {
+        guard let offset = commandOffset(in: slice) else { return }
+        let info = slice.base.advanced(by: offset).assumingMemoryBound(to: dyld_info_command.self).pointee
+
+        let (start, size): (UInt32, UInt32)
+        switch stream {
+        case .bind: (start, size) = (info.bind_off, info.bind_size)
+        case .weakBind: (start, size) = (info.weak_bind_off, info.weak_bind_size)
+        case .lazyBind: (start, size) = (info.lazy_bind_off, info.lazy_bind_size)
+        }
+        guard size > 0 else { return }
+        guard Int(start) + Int(size) <= slice.size else {
+            throw MachOError("Bind opcodes lie outside the image")
+        }
+
+        let bytes = UnsafeRawBufferPointer(start: slice.base.advanced(by: Int(start)), count: Int(size))
+        try interpret(bytes, lazy: stream == .lazyBind, body)
+    }
+
+    private static func interpret(_ bytes: UnsafeRawBufferPointer, lazy: Bool, _ body: (RawBind) throws -> Void) throws {
+        var state = RawBind()
+        var i = 0
+
+        func uleb() throws -> UInt64 {
+            var value: UInt64 = 0
+            var shift: UInt64 = 0
+            while true {
+                guard i < bytes.count, shift < 64 else {
+                    throw MachOError("Truncated ULEB128 in bind opcodes at \(i)")
+                }
+                let byte = bytes[i]
+                i += 1
+                value |= UInt64(byte & 0x7f) << shift
+                shift += 7
+                if byte & 0x80 == 0 { return value }
+            }
+        }
+
+        func sleb() throws -> Int64 {
+            var value: Int64 = 0
+            var shift: Int64 = 0
+            var byte: UInt8 = 0
+            repeat {
+                guard i < bytes.count, shift < 64 else {
+                    throw MachOError("Truncated SLEB128 in bind opcodes at \(i)")
+                }
+                byte = bytes[i]
+                i += 1
+                value |= Int64(byte & 0x7f) << shift
+                shift += 7
+            } while byte & 0x80 != 0
+            if shift < 64, byte & 0x40 != 0 {
+                value |= -1 << shift
+            }
+            return value
+        }
+
+        func bind() throws {
+            guard state.symbol != nil else {
+                throw MachOError("Bind without a symbol at \(i)")
+            }
+            try body(state)
+        }
+
+        while i < bytes.count {
+            let byte = bytes[i]
+            let opcode = byte & 0xf0
+            let immediate = byte & 0x0f
+            let opcodeOffset = i
+            i += 1
+
+            switch opcode {
+            case Opcode.done:
+                // The lazy stream is a run of entries, each ending in DONE
+                guard lazy else { return }
+                state = RawBind()
+                state.entryOffset = i
+
+            case Opcode.setDylibOrdinalImm:
+                state.libraryOrdinal = Int(immediate)
+                state.ordinalOpcode = opcodeOffset
+
+            case Opcode.setDylibOrdinalUleb:
+                state.libraryOrdinal = Int(truncatingIfNeeded: try uleb())
+                state.ordinalOpcode = opcodeOffset
+
+            case Opcode.setDylibSpecialImm:
+                state.libraryOrdinal = immediate == 0 ? 0 : Int(Int8(bitPattern: 0xf0 | immediate))
+                state.ordinalOpcode = opcodeOffset
+
+            case Opcode.setSymbolTrailingFlagsImm:
+                let name = bytes.baseAddress!.advanced(by: i)
+                guard let end = memchr(name, 0, bytes.count - i) else {
+                    throw MachOError("Unterminated symbol name in bind opcodes at \(i)")
+                }
+                state.symbol = UnsafePointer(name.assumingMemoryBound(to: CChar.self))
+                state.flags = immediate
+                state.symbolOpcode = opcodeOffset
+                i += UnsafeRawPointer(name).distance(to: UnsafeRawPointer(end)) + 1
+
+            case Opcode.setTypeImm:
+                state.type = immediate
+
+            case Opcode.setAddendSleb:
+                state.addend = try sleb()
+
+            case Opcode.setSegmentAndOffsetUleb:
+                state.segmentIndex = Int(immediate)
+                state.segmentOffset = try uleb()
+
+            case Opcode.addAddrUleb:
+                state.segmentOffset &+= try uleb()
+
+            case Opcode.doBind:
+                try bind()
+                state.segmentOffset &+= pointerSize
+
+            case Opcode.doBindAddAddrUleb:
+                try bind()
+                state.segmentOffset &+= try uleb() &+ pointerSize
+
+            case Opcode.doBindAddAddrImmScaled:
+                try bind()
+                state.segmentOffset &+= UInt64(immediate) * pointerSize + pointerSize
+
+            case Opcode.doBindUlebTimesSkippingUleb:
+                let count = try uleb()
+                let skip = try uleb()
+                for _ in 0..<count {
+                    try bind()
+                    state.segmentOffset &+= skip &+ pointerSize
+                }
+
+            case Opcode.threaded:
+                throw MachOError("Threaded binds are not supported")
+
+            default:
+                throw MachOError("Unknown bind opcode 0x\(String(byte, radix: 16)) at \(opcodeOffset)")
+            }
+        }
+    }
+
+    private static func bind(_ raw: RawBind) -> Bind {
+        Bind(libraryOrdinal: raw.libraryOrdinal, name: String(cString: raw.symbol!), flags: raw.flags, type: raw.type,
+             addend: raw.addend, segmentIndex: raw.segmentIndex, segmentOffset: raw.segmentOffset)
+    }
+
+    // MARK: - Editing
+
+    /// Throws if the imports named in `symbols` can't all be bound through
+    /// `path`, before `addLibrary` or `retarget` has changed a byte: lazy
+    /// entries whose ordinal opcode is too small for the new ordinal, and a
+    /// bind stream that outgrows its old space, need __LINKEDIT to be able to
+    /// grow, and the former also a `__stub_helper` that refers to every entry.
+    func checkRedirect(of symbols: Set<String>, toLibrary path: String) throws {
+        let ordinal = ordinal(ofLibrary: path) ?? libraries.count + 1
+
+        let lazy = lazyBinds.indices.filter { symbols.contains(lazyBinds[$0].bind.name) }
+        if !lazy.allSatisfy({ canSetLazyOrdinal(ordinal, of: $0) }) {
+            guard slice.canAppendToLinkedit else {
+                throw MachOError("Ordinal \(ordinal) doesn't fit the lazy binds, and __LINKEDIT can't grow to rebuild them")
+            }
+            _ = try stubHelperOffsetWords()
+        }
+
+        var retargeted = binds
+        var changed = false
+        for index in retargeted.indices where symbols.contains(retargeted[index].name) && retargeted[index].libraryOrdinal != ordinal {
+            retargeted[index].libraryOrdinal = ordinal
+            changed = true
+        }
+        if changed, command.pointee.bind_off == 0 || Self.encode(retargeted).count > Int(command.pointee.bind_size) {
+            guard slice.canAppendToLinkedit else {
+                throw MachOError("The rebuilt bind stream doesn't fit, and __LINKEDIT can't grow")
+            }
+        }
+    }
+
+    /// Returns the ordinal of `path`, adding a load command for it if the image
+    /// doesn't link it yet.
+    mutating func addLibrary(_ path: String, weak: Bool = false) throws -> Int {
+        if let ordinal = ordinal(ofLibrary: path) {
+            return ordinal
+        }
+
+        let cmd = weak ? MachOLoadCommand.loadWeakDylib : MachOLoadCommand.loadDylib
+        guard slice.appendLoadCommand(MachOSlice.dylibCommand(cmd, path: path)) else {
+            throw MachOError("No room to add a load command for \(path)")
+        }
+
+        // Making room may have dropped commands in front of ours
+        guard let offset = Self.commandOffset(in: slice) else {
+            throw MachOError("LC_DYLD_INFO disappeared while adding \(path)")
+        }
+        commandOffset = offset
+
+        libraries.append(path)
+        return libraries.count
+    }
+
+    /// Binds every import named `name` through `ordinal` and returns how many
+    /// there were. Lazy binds are rewritten immediately where their opcodes
+    /// allow; the rest, and the lazy stream when they don't, on `write()`.
+    /// Call `checkRedirect` first, which catches every case `write()` throws for.
+    @discardableResult
+    mutating func retarget(symbol name: String, toLibrary ordinal: Int) -> Int {
+        var count = 0
+        for index in binds.indices where binds[index].name == name && binds[index].libraryOrdinal != ordinal {
+            binds[index].libraryOrdinal = ordinal
+            needsRebuild = true
+            count += 1
+        }
+
+        let lazy = lazyBinds.indices.filter { lazyBinds[$0].bind.name == name }
+        if lazy.allSatisfy({ canSetLazyOrdinal(ordinal, of: $0) }) {
+            for index in lazy {
+                setLazyOrdinal(ordinal, of: index)
+            }
+        } else if !lazy.isEmpty {
+            for index in lazy {
+                lazyBinds[index].bind.libraryOrdinal = ordinal
+            }
+            needsLazyRebuild = true
+        }
+        return count + lazy.count
+    }
+
+    /// Drops the binds of `name`, leaving the pointers NULL. Lazy binds can't
+    /// be removed without moving the entries after them, so they become weak
+    /// imports instead, which dyld also binds to NULL when the symbol is missing.
+    @discardableResult
+    mutating func remove(symbol name: String) -> Int {
+        let before = binds.count
+        binds.removeAll { $0.name == name }
+        needsRebuild = needsRebuild || binds.count != before
+        var count = before - binds.count
+
+        let lazy = lazyStream
+        for index in lazyBinds.indices where lazyBinds[index].bind.name == name && !lazyBinds[index].bind.isWeakImport {
+            lazy.storeBytes(of: lazy.load(fromByteOffset: lazyBinds[index].symbolOpcode, as: UInt8.self) | Flag.weakImport, toByteOffset: lazyBinds[index].symbolOpcode, as: UInt8.self)
+            lazyBinds[index].bind.flags |= Flag.weakImport
+            count += 1
+        }
+        return count
+    }
+
+    private var lazyStream: UnsafeMutableRawPointer {
+        slice.base.advanced(by: Int(command.pointee.lazy_bind_off))
+    }
+
+    /// Length of the ULEB128 after the ordinal opcode at `opcodeOffset`, or 0
+    /// for the immediate forms.
+    private func lazyOrdinalLength(at opcodeOffset: Int) -> Int {
+        let opcode = lazyStream.advanced(by: opcodeOffset)
+        guard opcode.load(as: UInt8.self) & 0xf0 == Opcode.setDylibOrdinalUleb else { return 0 }
+
+        var length = 1
+        while opcode.load(fromByteOffset: length, as: UInt8.self) & 0x80 != 0 { length += 1 }
+        return length
+    }
+
+    /// Whether `setLazyOrdinal` can write `ordinal` over the entry's own
+    /// opcode: ld uses the 1-15 immediate form, so any later ordinal needs a
+    /// rebuilt stream, as does an opcode shared with another symbol.
+    private func canSetLazyOrdinal(_ ordinal: Int, of index: Int) -> Bool {
+        let entry = lazyBinds[index]
+        guard entry.bind.libraryOrdinal != ordinal else { return true }
+        guard let opcodeOffset = entry.ordinalOpcode,
+              !lazyBinds.contains(where: { $0.ordinalOpcode == opcodeOffset && $0.bind.name != entry.bind.name }) else {
+            return false
+        }
+
+        let length = lazyOrdinalLength(at: opcodeOffset)
+        if length > 0 {
+            return ordinal > 0 && UInt64(ordinal) >> (7 * length) == 0
+        }
+        return (-15...15).contains(ordinal)
+    }
+
+    /// Rewrites the ordinal opcode of a lazy entry without changing its
+    /// length. Only for entries `canSetLazyOrdinal` accepts.
+    private mutating func setLazyOrdinal(_ ordinal: Int, of index: Int) {
+        let entry = lazyBinds[index]
+        guard entry.bind.libraryOrdinal != ordinal, let opcodeOffset = entry.ordinalOpcode else { return }
+
+        let opcode = lazyStream.advanced(by: opcodeOffset)
+        let length = lazyOrdinalLength(at: opcodeOffset)
+
+        if length > 0 {
+            // Same length, padded with redundant continuation bytes
+            for byte in 0..<length {
+                let bits = UInt8(truncatingIfNeeded: ordinal >> (7 * byte)) & 0x7f
+                opcode.storeBytes(of: bits | (byte < length - 1 ? 0x80 : 0), toByteOffset: 1 + byte, as: UInt8.self)
+            }
+        } else if ordinal > 0 {
+            opcode.storeBytes(of: Opcode.setDylibOrdinalImm | UInt8(ordinal), as: UInt8.self)
+        } else {
+            opcode.storeBytes(of: Opcode.setDylibSpecialImm | UInt8(ordinal & 0xf), as: UInt8.self)
+        }
+
+        lazyBinds[index].bind.libraryOrdinal = ordinal
+    }
+
+    /// Where `__stub_helper` keeps the stream offset of each lazy entry, keyed
+    /// by that offset. After the shared header every entry is
+    /// `ldr w16, #8; b <header>; .long <offset>`.
+    private func stubHelperOffsetWords() throws -> [Int: Int] {
+        guard let section = slice.section("__TEXT", "__stub_helper"), let contents = slice.contents(of: section) else {
+            throw MachOError("No __stub_helper to point at a rebuilt lazy bind stream")
+        }
+        let sectionOffset = slice.base.distance(to: contents.baseAddress!)
+
+        var words: [Int: Int] = [:]
+        var i = 0
+        while i + 12 <= contents.count {
+            let load = contents.load(fromByteOffset: i, as: UInt32.self)
+            let branch = contents.load(fromByteOffset: i + 4, as: UInt32.self)
+            guard load == Self.stubHelperLoad, branch & 0xfc000000 == 0x14000000 else {
+                i += 4
+                continue
+            }
+
+            let entryOffset = Int(contents.load(fromByteOffset: i + 8, as: UInt32.self))
+            guard words.updateValue(sectionOffset + i + 8, forKey: entryOffset) == nil else {
+                throw MachOError("__stub_helper refers to lazy bind entry \(entryOffset) twice")
+            }
+            i += 12
+        }
+
+        let missing = lazyBinds.filter { words[$0.entryOffset] == nil }
+        guard missing.isEmpty else {
+            throw MachOError("__stub_helper doesn't refer to the lazy binds of \(missing.count) symbols")
+        }
+        return words
+    }
+
+    /// Re-encodes every lazy entry with its current ordinal at the end of
+    /// __LINKEDIT, the way ld lays them out, and points `__stub_helper` at
+    /// the new entry offsets. The old stream is left behind unused.
+    private mutating func rebuildLazyStream() throws {
+        let words = try stubHelperOffsetWords()
+
+        var out = ByteWriter()
+        var offsets: [(entry: Int, ordinal: Int, symbol: Int)] = []
+        for entry in lazyBinds {
+            let bind = entry.bind
+            let start = out.count
+            out.u8(Opcode.setSegmentAndOffsetUleb | UInt8(bind.segmentIndex & 0x0f))
+            out.uleb(bind.segmentOffset)
+            let ordinal = out.count
+            Self.writeOrdinal(bind.libraryOrdinal, to: &out)
+            let symbol = out.count
+            out.u8(Opcode.setSymbolTrailingFlagsImm | bind.flags & 0x0f)
+            out.cString(bind.name)
+            if bind.addend != 0 {
+                out.u8(Opcode.setAddendSleb)
+                out.sleb(bind.addend)
+            }
+            out.u8(Opcode.doBind)
+            out.u8(Opcode.done)
+            offsets.append((start, ordinal, symbol))
+        }
+        out.align(8)
+
+        let appended = try slice.appendingToLinkedit(out.bytes)
+        slice = appended.slice
+        command.pointee.lazy_bind_off = UInt32(appended.offset)
+        command.pointee.lazy_bind_size = UInt32(out.count)
+
+        for index in lazyBinds.indices {
+            slice.base.storeBytes(of: UInt32(offsets[index].entry), toByteOffset: words[lazyBinds[index].entryOffset]!, as: UInt32.self)
+            lazyBinds[index].entryOffset = offsets[index].entry
+            lazyBinds[index].ordinalOpcode = offsets[index].ordinal
+            lazyBinds[index].symbolOpcode = offsets[index].symbol
+        }
+    }
+
+    /// Re-encodes the bind stream if binds were retargeted or removed, and
+    /// the lazy stream if an ordinal didn't fit in place.
+    mutating func write() throws {
+        if needsLazyRebuild {
+            try rebuildLazyStream()
+            needsLazyRebuild = false
+        }
+        guard needsRebuild else { return }
+
+        let bytes = Self.encode(binds)
+        let oldOffset = Int(command.pointee.bind_off)
+        let oldSize = Int(command.pointee.bind_size)
+
+        if bytes.count <= oldSize, oldOffset > 0 {
+            let stream = slice.base.advanced(by: oldOffset)
+            memset(stream, 0, oldSize)
+            bytes.withUnsafeBytes { stream.copyMemory(from: $0.baseAddress!, byteCount: $0.count) }
+        } else {
+            let appended = try slice.appendingToLinkedit(bytes)
+            slice = appended.slice
+            command.pointee.bind_off = UInt32(appended.offset)
+        }
+        command.pointee.bind_size = UInt32(bytes.count)
+
+        needsRebuild = false
+    }
+
+    // MARK: - Encoding
+
+    /// Binds grouped by symbol and sorted by address within each group, the
+    /// way ld lays them out, so runs collapse into the scaled and repeating
+    /// DO_BIND forms.
+    static func encode(_ binds: [Bind]) -> [UInt8] {
+        let sorted = binds.sorted {
+            if ($0.libraryOrdinal, $0.name, $0.flags, $0.type, $0.addend) != ($1.libraryOrdinal, $1.name, $1.flags, $1.type, $1.addend) {
+                return ($0.libraryOrdinal, $0.name, $0.flags, $0.type, $0.addend) < ($1.libraryOrdinal, $1.name, $1.flags, $1.type, $1.addend)
+            }
+            return ($0.segmentIndex, $0.segmentOffset) < ($1.segmentIndex, $1.segmentOffset)
+        }
+
+        var out = ByteWriter()
+        var ordinal: Int?
+        var symbol: (name: String, flags: UInt8)?
+        var type: UInt8 = 0
+        var addend: Int64 = 0
+        var segment = -1
+        var address: UInt64 = 0
+
+        var i = 0
+        while i < sorted.count {
+            let bind = sorted[i]
+
+            if bind.libraryOrdinal != ordinal {
+                writeOrdinal(bind.libraryOrdinal, to: &out)
+                ordinal = bind.libraryOrdinal
+            }
+            if symbol?.name != bind.name || symbol?.flags != bind.flags {
+                out.u8(Opcode.setSymbolTrailingFlagsImm | bind.flags & 0x0f)
+                out.cString(bind.name)
+                symbol = (bind.name, bind.flags)
+            }
+            if bind.type != type {
+                out.u8(Opcode.setTypeImm | bind.type & 0x0f)
+                type = bind.type
+            }
+            if bind.addend != addend {
+                out.u8(Opcode.setAddendSleb)
+                out.sleb(bind.addend)
+                addend = bind.addend
+            }
+
+            if bind.segmentIndex != segment || bind.segmentOffset < address {
+                out.u8(Opcode.setSegmentAndOffsetUleb | UInt8(bind.segmentIndex & 0x0f))
+                out.uleb(bind.segmentOffset)
+                segment = bind.segmentIndex
+            } else if bind.segmentOffset > address {
+                out.u8(Opcode.addAddrUleb)
+                out.uleb(bind.segmentOffset - address)
+            }
+            address = bind.segmentOffset
+
+            // How far past the pointer the next bind of the same symbol is
+            func gap(after index: Int) -> UInt64? {
+                guard index + 1 < sorted.count else { return nil }
+                let current = sorted[index]
+                let next = sorted[index + 1]
+                guard next.name == current.name, next.libraryOrdinal == current.libraryOrdinal, next.flags == current.flags,
+                      next.type == current.type, next.addend == current.addend, next.segmentIndex == current.segmentIndex,
+                      next.segmentOffset >= current.segmentOffset + pointerSize else {
+                    return nil
+                }
+                return next.segmentOffset - current.segmentOffset - pointerSize
+            }
+
+            guard let skip = gap(after: i) else {
+                out.u8(Opcode.doBind)
+                address += pointerSize
+                i += 1
+                continue
+            }
+
+            var run = 1
+            while gap(after: i + run) == skip { run += 1 }
+
+            if run >= 3 {
+                out.u8(Opcode.doBindUlebTimesSkippingUleb)
+                out.uleb(UInt64(run))
+                out.uleb(skip)
+                address += UInt64(run) * (skip + pointerSize)
+                i += run
+            } else if skip % pointerSize == 0, skip / pointerSize < 16 {
+                out.u8(Opcode.doBindAddAddrImmScaled | UInt8(skip / pointerSize))
+                address += skip + pointerSize
+                i += 1
+            } else {
+                out.u8(Opcode.doBindAddAddrUleb)
+                out.uleb(skip)
+                address += skip + pointerSize
+                i += 1
+            }
+        }
+
+        out.u8(Opcode.done)
+        out.align(8)
+        return out.bytes
+    }
+
+    private static func writeOrdinal(_ ordinal: Int, to out: inout ByteWriter) {
+        if ordinal <= 0 {
+            out.u8(Opcode.setDylibSpecialImm | UInt8(ordinal & 0xf))
+        } else if ordinal <= 15 {
+            out.u8(Opcode.setDylibOrdinalImm | UInt8(ordinal))
+        } else {
+            out.u8(Opcode.setDylibOrdinalUleb)
+            out.uleb(UInt64(ordinal))
+        }
+    }
+}
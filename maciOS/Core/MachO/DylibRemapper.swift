@@ -0,0 +1,107 @@
+//
+//  DylibRemapper.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Rewrites the install names referenced by LC_LOAD_DYLIB, LC_LOAD_WEAK_DYLIB,
+/// LC_REEXPORT_DYLIB and LC_LOAD_UPWARD_DYLIB, plus LC_RPATH entries. Only the
+/// load commands are touched, so the cost is O(load commands) rather than
+/// O(file size × rules).
+struct DylibRemapper {
+    /// LC_RPATH keeps its lc_str at the same offset as dylib_command's name,
+    /// so both are rewritten the same way.
+    static let remappedCommands = MachOLoadCommand.dylibLoads.union([MachOLoadCommand.rpath])
+    
+    private let rules: FrameworkRemapRules
+    
+    init(_ rules: FrameworkRemapRules) {
+        self.rules = rules
+    }
+    
+    func replacement(for path: String) -> String? {
+        rules.replacement(for: path)
+    }
+    
+    /// Remaps every matching dylib command in `slice` and returns how many were rewritten.
+    @discardableResult
+    func remap(_ slice: MachOSlice) -> Int {
+        var pending = matches(in: slice)
+        guard !pending.isEmpty else { return 0 }
+        
+        // Make room for every rewrite up front. That may drop commands, which
+        // moves the rest, so look the matches up again afterwards.
+        let growth = pending.reduce(0) { total, match in
+            let command = slice.base.advanced(by: match.offset).assumingMemoryBound(to: dylib_command.self)
+            return total + max(0, Self.commandSize(for: match.path, in: command) - Int(command.pointee.cmdsize))
+        }
+        
+        if growth > 0 {
+            do {
+                try HeaderSpace(slice).reserve(growth)
+            } catch {
+                NSLog("Not enough header padding to remap dylibs: \(error)")
+            }
+            pending = matches(in: slice)
+        }
+        
+        // Rewrite back to front: growing a command only moves the commands after
+        // it, so the offsets we still have to visit stay valid.
+        var rewritten = 0
+        for (offset, path) in pending.reversed() {
+            if rewriteCommand(at: offset, to: path, in: slice) {
+                rewritten += 1
+            }
+        }
+        
+        return rewritten
+    }
+    
+    private func matches(in slice: MachOSlice) -> [(offset: Int, path: String)] {
+        var matches: [(offset: Int, path: String)] = []
+        
+        slice.forEachLoadCommand { command, offset in
+            if Self.remappedCommands.contains(command.pointee.cmd),
+               let name = slice.dylibName(command),
+               let replacement = rules.replacement(for: name) {
+                matches.append((offset, replacement))
+            }
+            return true
+        }
+        
+        return matches
+    }
+    
+    /// Size the command needs to hold `path`, never less than it already has.
+    private static func commandSize(for path: String, in command: UnsafeMutablePointer<dylib_command>) -> Int {
+        let required = Int(command.pointee.dylib.name.offset) + path.utf8.count + 1
+        return max(Int(command.pointee.cmdsize), (required + 7) & ~7)
+    }
+    
+    /// Stores `path` in the dylib command at `offset`, growing the command into
+    /// the header padding when the new name doesn't fit. Nothing past the load
+    /// commands is ever shifted.
+    private func rewriteCommand(at offset: Int, to path: String, in slice: MachOSlice) -> Bool {
+        let command = slice.base.advanced(by: offset).assumingMemoryBound(to: dylib_command.self)
+        let nameOffset = Int(command.pointee.dylib.name.offset)
+        let newSize = Self.commandSize(for: path, in: command)
+        
+        do {
+            try HeaderSpace(slice).resize(commandAt: offset, to: newSize)
+        } catch {
+            NSLog("Can't remap to \(path): \(error)")
+            return false
+        }
+        
+        let namePtr = UnsafeMutableRawPointer(command).advanced(by: nameOffset)
+        memset(namePtr, 0, Int(command.pointee.cmdsize) - nameOffset)
+        path.utf8CString.withUnsafeBytes { namePtr.copyMemory(from: $0.baseAddress!, byteCount: $0.count - 1) }
+        
+        return true
+    }
+}
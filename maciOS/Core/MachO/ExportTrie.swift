@@ -0,0 +1,392 @@
+//
+//  ExportTrie.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Reader for the export trie of an image, from LC_DYLD_EXPORTS_TRIE or the
+/// export range of LC_DYLD_INFO(_ONLY). Lookups walk the trie directly, which
+/// costs one pass over the name; `forEach` visits every export while reusing
+/// a single name buffer.
+struct ExportTrie {
+    struct Export: Equatable {
+        static let kindMask: UInt64 = 0x3
+        static let weakDefinition: UInt64 = 0x4
+        static let reexport: UInt64 = 0x8
+        static let stubAndResolver: UInt64 = 0x10
+
+        let flags: UInt64
+        /// Image offset of the symbol, or the library ordinal for re-exports.
+        let address: UInt64
+        /// Resolver offset for stub-and-resolver exports.
+        let other: UInt64
+        /// Name in the re-exported library, when it differs.
+        let importName: String?
+
+        var isReexport: Bool { flags & Self.reexport != 0 }
+        var isWeak: Bool { flags & Self.weakDefinition != 0 }
+        var isThreadLocal: Bool { flags & Self.kindMask == 1 }
+        var isAbsolute: Bool { flags & Self.kindMask == 2 }
+    }
+
+    /// Keeps the mapping `bytes` points into alive.
+    let file: MappedFile
+    let bytes: UnsafeRawBufferPointer
+
+    /// Returns nil when the slice exports nothing.
+    init?(_ slice: MachOSlice) {
+        var range: (offset: Int, size: Int)?
+
+        slice.forEachLoadCommand { command, _ in
+            switch command.pointee.cmd {
+            case MachOLoadCommand.dyldExportsTrie:
+                let data = UnsafeMutableRawPointer(command).assumingMemoryBound(to: linkedit_data_command.self)
+                range = (Int(data.pointee.dataoff), Int(data.pointee.datasize))
+                return false
+            case MachOLoadCommand.dyldInfo, MachOLoadCommand.dyldInfoOnly:
+                let info = UnsafeMutableRawPointer(command).assumingMemoryBound(to: dyld_info_command.self)
+                range = (Int(info.pointee.export_off), Int(info.pointee.export_size))
+                return false
+            default:
+                return true
+            }
+        }
+
+        guard let range, range.size > 0, range.offset + range.size <= slice.size else { return nil }
+
+        file = slice.file
+        bytes = UnsafeRawBufferPointer(start: slice.base.advanced(by: range.offset), count: range.size)
+    }
+
+    /// The trie of the arm64 slice the host would load from `path`.
+    static func open(_ path: String) throws -> ExportTrie? {
+        let file = try MappedFile(path: path, writable: false)
+        return try file.preferredARM64Slice().flatMap { ExportTrie($0) }
+    }
+
+    func lookup(_ name: String) -> Export? {
+        var name = name
+        return name.withUTF8 { lookup(UnsafeRawBufferPointer($0)) }
+    }
+
+    func lookup(_ name: UnsafeRawBufferPointer) -> Export? {
+        var node = 0
+        var matched = 0
+        // Every hop moves strictly deeper into the name, so this bounds malformed tries too.
+        var hops = 0
+
+        while hops <= name.count {
+            hops += 1
+
+            var cursor = node
+            guard let terminalSize = readULEB(&cursor) else { return nil }
+
+            if matched == name.count {
+                return terminalSize > 0 ? readTerminal(at: cursor) : nil
+            }
+
+            cursor += Int(terminalSize)
+            guard cursor < bytes.count else { return nil }
+
+            let childCount = Int(bytes[cursor])
+            cursor += 1
+
+            var next: Int?
+            for _ in 0..<childCount {
+                let edgeStart = cursor
+                while cursor < bytes.count, bytes[cursor] != 0 { cursor += 1 }
+                let edgeLength = cursor - edgeStart
+                cursor += 1
+
+                guard let childOffset = readULEB(&cursor) else { return nil }
+
+                if edgeLength <= name.count - matched,
+                   memcmp(bytes.baseAddress! + edgeStart, name.baseAddress! + matched, edgeLength) == 0 {
+                    matched += edgeLength
+                    next = Int(childOffset)
+                    break
+                }
+            }
+
+            guard let next, next < bytes.count else { return nil }
+            node = next
+        }
+
+        return nil
+    }
+
+    /// Calls `body` with every exported name and its export info. The name
+    /// buffer is only valid during the call.
+    func forEach(_ body: (UnsafeBufferPointer<UInt8>, Export) -> Void) {
+        var name: [UInt8] = []
+        name.reserveCapacity(256)
+        var visited = 0
+        walk(0, &name, &visited, body)
+    }
+
+    var names: [String] {
+        var names: [String] = []
+        forEach { name, _ in names.append(String(decoding: name, as: UTF8.self)) }
+        return names
+    }
+
+    private func walk(_ node: Int, _ name: inout [UInt8], _ visited: inout Int, _ body: (UnsafeBufferPointer<UInt8>, Export) -> Void) {
+        // A well-formed trie has fewer nodes than bytes; anything else is a cycle.
+        visited += 1
+        guard visited <= bytes.count, node < bytes.count else { return }
+
+        var cursor = node
+        guard let terminalSize = readULEB(&cursor) else { return }
+
+        if terminalSize > 0, let export = readTerminal(at: cursor) {
+            name.withUnsafeBufferPointer { body($0, export) }
+        }
+
+        cursor += Int(terminalSize)
+        guard cursor < bytes.count else { return }
+
+        let childCount = Int(bytes[cursor])
+        cursor += 1
+
+        for _ in 0..<childCount {
+            let edgeStart = cursor
+            while cursor < bytes.count, bytes[cursor] != 0 { cursor += 1 }
+            let edge = bytes[edgeStart..<cursor]
+            cursor += 1
+
+            guard let childOffset = readULEB(&cursor) else { return }
+
+            name.append(contentsOf: edge)
+            walk(Int(childOffset), &name, &visited, body)
+            name.removeLast(edge.count)
+        }
+    }
+
+    private func readTerminal(at offset: Int) -> Export? {
+        var cursor = offset
+        guard let flags = readULEB(&cursor) else { return nil }
+
+        if flags & Export.reexport != 0 {
+            guard let ordinal = readULEB(&cursor) else { return nil }
+            let start = cursor
+            while cursor < bytes.count, bytes[cursor] != 0 { cursor += 1 }
+            let importName = String(decoding: bytes[start..<cursor], as: UTF8.self)
+            return Export(flags: flags, address: ordinal, other: 0, importName: importName.isEmpty ? nil : importName)
+        }
+
+        guard let address = readULEB(&cursor) else { return nil }
+
+        var resolver: UInt64 = 0
+        if flags & Export.stubAndResolver != 0 {
+            guard let value = readULEB(&cursor) else { return nil }
+            resolver = value
+        }
+
+        return Export(flags: flags, address: address, other: resolver, importName: nil)
+    }
+
+    private func readULEB(_ cursor: inout Int) -> UInt64? {
+        var result: UInt64 = 0
+        var shift: UInt64 = 0
+
+        while cursor < bytes.count {
+            let byte = bytes[cursor]
+            cursor += 1
+
+            guard shift < 64 else { return nil }
+            result |= UInt64(byte & 0x7f) << shift
+            shift += 7
+
+            if byte & 0x80 == 0 {
+                return result
+            }
+        }
+        return nil
+    }
+}
+
+/// An export trie flattened into an mmap-able file: a name-sorted entry table,
+/// an open-addressing hash index over it and a string pool. Opening one is a
+/// single mmap, and a lookup is one hash plus usually one probe.
+final class ExportIndex {
+    static let magic: UInt32 = 0x5849_584d // "MXIX"
+    static let version: UInt32 = 1
+
+    private enum Layout {
+        static let headerSize = 32
+        static let entrySize = 40
+    }
+
+    private let file: MappedFile
+    let count: Int
+    private let slotCount: Int
+    private let entries: UnsafeRawPointer
+    private let slots: UnsafePointer<UInt32>
+    private let strings: UnsafeRawBufferPointer
+
+    init(path: String) throws {
+        file = try MappedFile(path: path, writable: false)
+        let base = UnsafeRawPointer(file.base)
+        let field = { (index: Int) in Int(base.load(fromByteOffset: index * 4, as: UInt32.self)) }
+
+        guard field(0) == Self.magic, field(1) == Self.version else {
+            throw MachOError("\(path) is not a current export index")
+        }
+
+        count = field(2)
+        slotCount = field(3)
+        let entriesOffset = field(4)
+        let slotsOffset = field(5)
+        let stringsOffset = field(6)
+
+        guard slotCount > 0, slotCount & (slotCount - 1) == 0,
+              entriesOffset + count * Layout.entrySize <= file.size,
+              slotsOffset + slotCount * 4 <= file.size,
+              stringsOffset <= file.size else {
+            throw MachOError("\(path) is truncated")
+        }
+
+        entries = base + entriesOffset
+        slots = (base + slotsOffset).assumingMemoryBound(to: UInt32.self)
+        strings = UnsafeRawBufferPointer(start: base + stringsOffset, count: file.size - stringsOffset)
+    }
+
+    /// The index for the image at `imagePath`, built on first use and kept in
+    /// `Caches/ExportIndexes/` under the image's content digest.
+    static func cached(for imagePath: String) throws -> ExportIndex? {
+        let directory = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0].appendingPathComponent("ExportIndexes")
+        let digest = try PatchCache.shared.contentDigest(of: URL(fileURLWithPath: imagePath))
+        let indexURL = directory.appendingPathComponent(digest + ".exports")
+
+        if let index = try? ExportIndex(path: indexURL.path) {
+            return index
+        }
+
+        guard let trie = try ExportTrie.open(imagePath) else { return nil }
+
+        try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        try build(from: trie).write(to: indexURL, options: .atomic)
+        return try ExportIndex(path: indexURL.path)
+    }
+
+    /// Serialises every export in `trie`.
+    static func build(from trie: ExportTrie) -> Data {
+        var exports: [(name: [UInt8], export: ExportTrie.Export)] = []
+        trie.forEach { name, export in exports.append((Array(name), export)) }
+        exports.sort { $0.name.lexicographicallyPrecedes($1.name) }
+
+        var slotCount = 1
+        while slotCount < max(exports.count, 1) * 2 { slotCount <<= 1 }
+
+        let entriesOffset = Layout.headerSize
+        let slotsOffset = entriesOffset + exports.count * Layout.entrySize
+        let stringsOffset = slotsOffset + slotCount * 4
+
+        var strings: [UInt8] = []
+        var data = Data(count: stringsOffset)
+
+        data.withUnsafeMutableBytes { raw in
+            let base = raw.baseAddress!
+            for (i, value) in [magic, version, UInt32(exports.count), UInt32(slotCount), UInt32(entriesOffset), UInt32(slotsOffset), UInt32(stringsOffset), 0].enumerated() {
+                base.storeBytes(of: value, toByteOffset: i * 4, as: UInt32.self)
+            }
+
+            let slots = (base + slotsOffset).assumingMemoryBound(to: UInt32.self)
+            let mask = slotCount - 1
+
+            for (i, item) in exports.enumerated() {
+                let entry = base + entriesOffset + i * Layout.entrySize
+                entry.storeBytes(of: UInt32(strings.count), toByteOffset: 0, as: UInt32.self)
+                entry.storeBytes(of: UInt32(item.name.count), toByteOffset: 4, as: UInt32.self)
+                strings.append(contentsOf: item.name)
+
+                if let importName = item.export.importName {
+                    entry.storeBytes(of: UInt32(strings.count), toByteOffset: 8, as: UInt32.self)
+                    entry.storeBytes(of: UInt32(importName.utf8.count), toByteOffset: 12, as: UInt32.self)
+                    strings.append(contentsOf: importName.utf8)
+                } else {
+                    entry.storeBytes(of: UInt32.max, toByteOffset: 8, as: UInt32.self)
+                    entry.storeBytes(of: UInt32(0), toByteOffset: 12, as: UInt32.self)
+                }
+
+                entry.storeBytes(of: item.export.flags, toByteOffset: 16, as: UInt64.self)
+                entry.storeBytes(of: item.export.address, toByteOffset: 24, as: UInt64.self)
+                entry.storeBytes(of: item.export.other, toByteOffset: 32, as: UInt64.self)
+
+                var slot = item.name.withUnsafeBytes { Int(truncatingIfNeeded: hash($0)) } & mask
+                while slots[slot] != 0 { slot = (slot + 1) & mask }
+                slots[slot] = UInt32(i + 1)
+            }
+        }
+
+        data.append(contentsOf: strings)
+        return data
+    }
+
+    func lookup(_ name: String) -> ExportTrie.Export? {
+        var name = name
+        return name.withUTF8 { buffer in
+            let bytes = UnsafeRawBufferPointer(buffer)
+            let mask = slotCount - 1
+            var slot = Int(truncatingIfNeeded: Self.hash(bytes)) & mask
+
+            while slots[slot] != 0 {
+                let index = Int(slots[slot]) - 1
+                if index < count, self.name(at: index).elementsEqual(bytes) {
+                    return export(at: index)
+                }
+                slot = (slot + 1) & mask
+            }
+            return nil
+        }
+    }
+
+    func contains(_ name: String) -> Bool {
+        lookup(name) != nil
+    }
+
+    /// Every export, in name order.
+    func forEach(_ body: (UnsafeRawBufferPointer, ExportTrie.Export) -> Void) {
+        for index in 0..<count {
+            body(name(at: index), export(at: index))
+        }
+    }
+
+    private func name(at index: Int) -> UnsafeRawBufferPointer {
+        let entry = entries + index * Layout.entrySize
+        return string(entry.load(fromByteOffset: 0, as: UInt32.self), entry.load(fromByteOffset: 4, as: UInt32.self))
+    }
+
+    private func export(at index: Int) -> ExportTrie.Export {
+        let entry = entries + index * Layout.entrySize
+        let importOffset = entry.load(fromByteOffset: 8, as: UInt32.self)
+        let importName = importOffset == UInt32.max ? nil : String(decoding: string(importOffset, entry.load(fromByteOffset: 12, as: UInt32.self)), as: UTF8.self)
+
+        return ExportTrie.Export(
+            flags: entry.load(fromByteOffset: 16, as: UInt64.self),
+            address: entry.load(fromByteOffset: 24, as: UInt64.self),
+            other: entry.load(fromByteOffset: 32, as: UInt64.self),
+            importName: importName
+        )
+    }
+
+    private func string(_ offset: UInt32, _ length: UInt32) -> UnsafeRawBufferPointer {
+        let start = min(Int(offset), strings.count)
+        let end = min(start + Int(length), strings.count)
+        return UnsafeRawBufferPointer(rebasing: strings[start..<end])
+    }
+
+    /// FNV-1a, stable across launches so indexes can live on disk.
+    private static func hash(_ bytes: UnsafeRawBufferPointer) -> UInt64 {
+        var hash: UInt64 = 0xcbf29ce484222325
+        for byte in bytes {
+            hash = (hash ^ UInt64(byte)) &* 0x100000001b3
+        }
+        return hash
+    }
+}
@@ -0,0 +1,323 @@
+//
+//  FrameworkRemapRules.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import CryptoKit
+import Foundation
+
+/// The install name remaps applied to patched images, loaded from the bundled
+/// `FrameworkRemaps.rules` plus an optional per-app override file (see that
+/// file for the format).
+///
+/// Each rule file compiles once into a table: exact rules into a perfect hash,
+/// prefix and template rules into a byte trie keyed by their literal start. A
+/// lookup is one hash probe plus one walk down the trie along the path, so its
+/// cost follows the path length, not the number of rules.
+struct FrameworkRemapRules {
+    static let bundledResource = "FrameworkRemaps"
+    static let overridesDirectory = URL.documentsDirectory.appendingPathComponent("RemapRules", isDirectory: true)
+
+    /// Checked last to first, so overrides win over the bundled rules.
+    private let layers: [Table]
+
+    /// Identifies the rules for the patch cache key.
+    let version: String
+
+    static let bundled: FrameworkRemapRules = {
+        guard let url = Bundle.main.url(forResource: bundledResource, withExtension: "rules"),
+              let source = try? String(contentsOf: url, encoding: .utf8) else {
+            NSLog("\(bundledResource).rules is missing from the app bundle")
+            return FrameworkRemapRules(layers: [])
+        }
+        return FrameworkRemapRules(layers: [Table(source: source, origin: url.lastPathComponent)])
+    }()
+
+    private static let lock = NSLock()
+    private static var overrides: [String: (date: Date, rules: FrameworkRemapRules)] = [:]
+
+    /// The bundled rules with `Documents/RemapRules/<appName>.rules` on top, if
+    /// it exists. Compiled once per app and again only when the file changes.
+    static func load(for appName: String) -> FrameworkRemapRules {
+        let url = overridesDirectory.appendingPathComponent(appName + ".rules")
+        guard let date = (try? url.resourceValues(forKeys: [.contentModificationDateKey]))?.contentModificationDate else {
+            return bundled
+        }
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        if let cached = overrides[appName], cached.date == date {
+            return cached.rules
+        }
+
+        guard let source = try? String(contentsOf: url, encoding: .utf8) else {
+            NSLog("Couldn't read remap overrides for \(appName)")
+            return bundled
+        }
+
+        NSLog("Using remap overrides for \(appName)")
+        let rules = FrameworkRemapRules(layers: bundled.layers + [Table(source: source, origin: url.lastPathComponent)])
+        overrides[appName] = (date, rules)
+        return rules
+    }
+
+    private init(layers: [Table]) {
+        self.layers = layers
+
+        var hasher = SHA256()
+        for layer in layers {
+            hasher.update(data: Data(layer.digest.utf8))
+        }
+        version = hasher.finalize().map { String(format: "%02x", $0) }.joined()
+    }
+
+    /// These rules with exact `remaps` on top.
+    func adding(_ remaps: [(String, String)]) -> FrameworkRemapRules {
+        guard !remaps.isEmpty else { return self }
+        return FrameworkRemapRules(layers: layers + [Table(exact: remaps)])
+    }
+
+    func replacement(for path: String) -> String? {
+        for layer in layers.reversed() {
+            if let replacement = layer.replacement(for: path) {
+                return replacement
+            }
+        }
+        return nil
+    }
+
+    /// Bytes every match starts with: the exact paths and the literal start of
+    /// each prefix and template rule. String scanners look for these and then
+    /// ask `replacement(for:)` about the whole string.
+    var triggers: [[UInt8]] {
+        var seen = Set<[UInt8]>()
+        return layers.flatMap(\.triggers).filter { seen.insert($0).inserted }
+    }
+
+    var exactPaths: [String] {
+        layers.flatMap { $0.exact.names.map { String(decoding: $0, as: UTF8.self) } }
+    }
+}
+
+// MARK: - Compiled table
+
+private extension FrameworkRemapRules {
+    enum Token {
+        case literal([UInt8])
+        case variable(String)
+    }
+
+    struct PatternRule {
+        let isPrefix: Bool
+        let pattern: [Token]
+        let replacement: [Token]
+    }
+
+    struct TrieNode {
+        var children: [UInt8: Int32] = [:]
+        /// Rules whose literal start ends here, templates before prefixes.
+        var rules: [Int32] = []
+    }
+
+    struct Table {
+        let exact: SymbolNameSet
+        let exactReplacements: [String]
+        let patternRules: [PatternRule]
+        let trie: [TrieNode]
+        let triggers: [[UInt8]]
+        let digest: String
+
+        init(source: String, origin: String) {
+            var exact: [(String, String)] = []
+            var templates: [PatternRule] = []
+            var prefixes: [PatternRule] = []
+
+            for (number, line) in source.split(separator: "\n", omittingEmptySubsequences: false).enumerated() {
+                let fields = line.split(whereSeparator: { $0 == " " || $0 == "\t" })
+                guard let kind = fields.first, !kind.hasPrefix("#") else { continue }
+
+                guard fields.count == 3 else {
+                    NSLog("\(origin):\(number + 1): expected a kind and two paths")
+                    continue
+                }
+
+                let from = String(fields[1])
+                let to = String(fields[2])
+
+                switch kind {
+                case "exact":
+                    exact.append((from, to))
+                case "prefix":
+                    prefixes.append(PatternRule(isPrefix: true, pattern: [.literal(Array(from.utf8))], replacement: [.literal(Array(to.utf8))]))
+                case "template":
+                    let pattern = Self.tokenize(from)
+                    let replacement = Self.tokenize(to)
+                    let bound = Set(pattern.compactMap { if case .variable(let name) = $0 { return name } else { return nil } })
+                    let unbound = replacement.compactMap { if case .variable(let name) = $0, !bound.contains(name) { return name } else { return nil } }
+
+                    guard unbound.isEmpty else {
+                        NSLog("\(origin):\(number + 1): $\(unbound[0]) isn't in the pattern")
+                        continue
+                    }
+                    templates.append(PatternRule(isPrefix: false, pattern: pattern, replacement: replacement))
+                default:
+                    NSLog("\(origin):\(number + 1): unknown rule kind \(kind)")
+                }
+            }
+
+            self.init(exact: exact, patternRules: templates + prefixes, digestSource: Data(source.utf8))
+        }
+
+        init(exact: [(String, String)]) {
+            let source = exact.map { "\($0.0)\u{0}\($0.1)\u{0}" }.joined()
+            self.init(exact: exact, patternRules: [], digestSource: Data(source.utf8))
+        }
+
+        private init(exact pairs: [(String, String)], patternRules: [PatternRule], digestSource: Data) {
+            // Duplicates keep the first rule, same as the old tuple order
+            let replacements = Dictionary(pairs, uniquingKeysWith: { first, _ in first })
+            exact = SymbolNameSet(pairs.map(\.0))
+            exactReplacements = exact.names.map { replacements[String(decoding: $0, as: UTF8.self)]! }
+
+            var trie = [TrieNode()]
+            for (index, rule) in patternRules.enumerated() {
+                var node = 0
+                for byte in Self.literalStart(of: rule.pattern) {
+                    if let next = trie[node].children[byte] {
+                        node = Int(next)
+                    } else {
+                        trie[node].children[byte] = Int32(trie.count)
+                        node = trie.count
+                        trie.append(TrieNode())
+                    }
+                }
+                trie[node].rules.append(Int32(index))
+            }
+
+            self.patternRules = patternRules
+            self.trie = trie
+            triggers = exact.names + patternRules.map { Self.literalStart(of: $0.pattern) }.filter { !$0.isEmpty }
+            digest = SHA256.hash(data: digestSource).map { String(format: "%02x", $0) }.joined()
+        }
+
+        func replacement(for path: String) -> String? {
+            if let index = exact.index(of: path) {
+                return exactReplacements[index]
+            }
+
+            let bytes = Array(path.utf8)
+            var visited = [trie[0].rules]
+            var node = 0
+
+            for byte in bytes {
+                guard let next = trie[node].children[byte] else { break }
+                node = Int(next)
+                if !trie[node].rules.isEmpty {
+                    visited.append(trie[node].rules)
+                }
+            }
+
+            // Deepest literal start first; within a node, templates before prefixes
+            for index in visited.reversed().joined() {
+                let rule = patternRules[Int(index)]
+
+                if rule.isPrefix {
+                    guard case .literal(let prefix) = rule.pattern[0], case .literal(let replacement) = rule.replacement[0] else { continue }
+                    return String(decoding: replacement + bytes[prefix.count...], as: UTF8.self)
+                }
+
+                if let bindings = Self.match(rule.pattern[...], bytes[...], [:]) {
+                    return String(decoding: Self.expand(rule.replacement, bindings), as: UTF8.self)
+                }
+            }
+
+            return nil
+        }
+
+        /// `$NAME` becomes a variable; everything else is literal.
+        private static func tokenize(_ text: String) -> [Token] {
+            let bytes = Array(text.utf8)
+            var tokens: [Token] = []
+            var literal: [UInt8] = []
+            var i = 0
+
+            func isNameByte(_ byte: UInt8) -> Bool {
+                (byte >= UInt8(ascii: "A") && byte <= UInt8(ascii: "Z")) || (byte >= UInt8(ascii: "a") && byte <= UInt8(ascii: "z"))
+                    || (byte >= UInt8(ascii: "0") && byte <= UInt8(ascii: "9")) || byte == UInt8(ascii: "_")
+            }
+
+            while i < bytes.count {
+                if bytes[i] == UInt8(ascii: "$"), i + 1 < bytes.count, isNameByte(bytes[i + 1]) {
+                    var end = i + 1
+                    while end < bytes.count, isNameByte(bytes[end]) { end += 1 }
+
+                    if !literal.isEmpty {
+                        tokens.append(.literal(literal))
+                        literal = []
+                    }
+                    tokens.append(.variable(String(decoding: bytes[i + 1..<end], as: UTF8.self)))
+                    i = end
+                } else {
+                    literal.append(bytes[i])
+                    i += 1
+                }
+            }
+
+            if !literal.isEmpty {
+                tokens.append(.literal(literal))
+            }
+            return tokens
+        }
+
+        private static func literalStart(of pattern: [Token]) -> [UInt8] {
+            if case .literal(let bytes) = pattern.first {
+                return bytes
+            }
+            return []
+        }
+
+        /// Matches the whole of `path`. A variable takes one or more bytes of a
+        /// single path component, and a variable seen before must repeat its text.
+        private static func match(_ tokens: ArraySlice<Token>, _ path: ArraySlice<UInt8>, _ bindings: [String: ArraySlice<UInt8>]) -> [String: ArraySlice<UInt8>]? {
+            guard let token = tokens.first else {
+                return path.isEmpty ? bindings : nil
+            }
+            let rest = tokens.dropFirst()
+
+            switch token {
+            case .literal(let bytes):
+                guard path.starts(with: bytes) else { return nil }
+                return match(rest, path.dropFirst(bytes.count), bindings)
+
+            case .variable(let name):
+                if let bound = bindings[name] {
+                    guard path.starts(with: bound) else { return nil }
+                    return match(rest, path.dropFirst(bound.count), bindings)
+                }
+
+                var bindings = bindings
+                var end = path.startIndex
+                while end < path.endIndex, path[end] != UInt8(ascii: "/") {
+                    end += 1
+                    bindings[name] = path[path.startIndex..<end]
+                    if let result = match(rest, path[end...], bindings) {
+                        return result
+                    }
+                }
+                return nil
+            }
+        }
+
+        private static func expand(_ tokens: [Token], _ bindings: [String: ArraySlice<UInt8>]) -> [UInt8] {
+            tokens.flatMap { token -> [UInt8] in
+                switch token {
+                case .literal(let bytes): return bytes
+                case .variable(let name): return Array(bindings[name] ?? [])
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,138 @@
+//
+//  HeaderSpace.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Allocator for the padding between the load commands and the first section
+/// of an image. Every load command insertion or growth goes through here, so
+/// nothing is ever written past the real free space into `__text`.
+///
+/// When the padding runs out, commands that patching invalidates anyway or
+/// that only tooling reads are given up. Moving section contents further into
+/// the file is not an option: in `__TEXT` a section's file offset fixes its
+/// address relative to the header, and every export, fixup and LC_MAIN offset
+/// is measured from that header.
+struct HeaderSpace {
+    /// Commands that can go, in the order they are given up. The signature is
+    /// invalid once anything is patched; the rest only matter to debuggers,
+    /// symbolication and the static linker.
+    static let expendable: [UInt32] = [
+        MachOLoadCommand.codeSignature,
+        0x2b, // LC_DYLIB_CODE_SIGN_DRS
+        0x2e, // LC_LINKER_OPTIMIZATION_HINT
+        0x2a, // LC_SOURCE_VERSION
+        0x29, // LC_DATA_IN_CODE
+        0x26, // LC_FUNCTION_STARTS
+    ]
+
+    let slice: MachOSlice
+
+    init(_ slice: MachOSlice) {
+        self.slice = slice
+    }
+
+    var free: Int {
+        slice.loadCommandsFreeSpace
+    }
+
+    private var commandsEnd: Int {
+        slice.loadCommandsOffset + Int(slice.header.pointee.sizeofcmds)
+    }
+
+    /// Makes room for `bytes` more bytes of load commands, removing expendable
+    /// commands if the padding is too small. Removing commands moves the ones
+    /// after them, so offsets taken before this call must be looked up again.
+    func reserve(_ bytes: Int) throws {
+        guard free < bytes else { return }
+
+        for cmd in Self.expendable {
+            var found: Int?
+            slice.forEachLoadCommand { command, offset in
+                if command.pointee.cmd == cmd {
+                    found = offset
+                    return false
+                }
+                return true
+            }
+
+            if let found {
+                NSLog("Dropping load command 0x\(String(cmd, radix: 16)) to make room in the header")
+                removeCommand(at: found)
+                if free >= bytes { return }
+            }
+        }
+
+        throw MachOError("Header padding is \(free) bytes, \(bytes) needed")
+    }
+
+    /// Inserts a command, padded to 8 bytes, at `offset` (default: after the
+    /// last command). Never gives anything up; call `reserve` first for that.
+    func insert(_ command: [UInt8], at offset: Int? = nil) throws {
+        guard command.count % 8 == 0, command.count >= MemoryLayout<load_command>.size else {
+            throw MachOError("Malformed load command of \(command.count) bytes")
+        }
+        guard free >= command.count else {
+            throw MachOError("Header padding is \(free) bytes, \(command.count) needed")
+        }
+
+        let end = commandsEnd
+        let offset = offset ?? end
+        guard offset >= slice.loadCommandsOffset, offset <= end else {
+            throw MachOError("Load command offset \(offset) is outside the commands")
+        }
+
+        memmove(slice.base.advanced(by: offset + command.count), slice.base.advanced(by: offset), end - offset)
+        command.withUnsafeBytes { slice.base.advanced(by: offset).copyMemory(from: $0.baseAddress!, byteCount: $0.count) }
+
+        slice.header.pointee.ncmds += 1
+        slice.header.pointee.sizeofcmds += UInt32(command.count)
+    }
+
+    /// Grows or shrinks the command at `offset` to `newSize` bytes, moving the
+    /// commands after it. Added bytes are zeroed.
+    func resize(commandAt offset: Int, to newSize: Int) throws {
+        let command = slice.base.advanced(by: offset).assumingMemoryBound(to: load_command.self)
+        let oldSize = Int(command.pointee.cmdsize)
+        let delta = newSize - oldSize
+        guard delta != 0 else { return }
+
+        guard newSize % 8 == 0, newSize >= MemoryLayout<load_command>.size else {
+            throw MachOError("Load command size \(newSize) is not a multiple of 8")
+        }
+        guard free >= delta else {
+            throw MachOError("Header padding is \(free) bytes, \(delta) needed")
+        }
+
+        let end = commandsEnd
+        let tail = offset + oldSize
+        memmove(slice.base.advanced(by: tail + delta), slice.base.advanced(by: tail), end - tail)
+
+        if delta > 0 {
+            memset(slice.base.advanced(by: tail), 0, delta)
+        } else {
+            memset(slice.base.advanced(by: end + delta), 0, -delta)
+        }
+
+        command.pointee.cmdsize = UInt32(newSize)
+        slice.header.pointee.sizeofcmds = UInt32(Int(slice.header.pointee.sizeofcmds) + delta)
+    }
+
+    /// Removes the command at `offset`, moving the ones after it down and
+    /// zeroing the space it leaves at the end.
+    func removeCommand(at offset: Int) {
+        let size = Int(slice.base.advanced(by: offset).assumingMemoryBound(to: load_command.self).pointee.cmdsize)
+        let end = commandsEnd
+
+        memmove(slice.base.advanced(by: offset), slice.base.advanced(by: offset + size), end - offset - size)
+        memset(slice.base.advanced(by: end - size), 0, size)
+
+        slice.header.pointee.ncmds -= 1
+        slice.header.pointee.sizeofcmds -= UInt32(size)
+    }
+}
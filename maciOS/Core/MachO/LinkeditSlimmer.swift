@@ -0,0 +1,284 @@
+//
+//  LinkeditSlimmer.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Drops the parts of __LINKEDIT nothing at runtime reads: local symbols,
+/// debug stabs and the strings only they use. The symbol table keeps the
+/// defined externals and the undefineds, and every index into it
+/// (LC_DYSYMTAB ranges, the indirect symbol table, external relocations) is
+/// renumbered. The remaining __LINKEDIT blobs are packed in their original
+/// order and the file is truncated after them.
+///
+/// Binds, chained fixups and the export trie refer to symbols by name, so
+/// they are moved but not changed. Only the thin image of a whole file can be
+/// slimmed, since anything after it would move.
+struct LinkeditSlimmer {
+    struct Result {
+        let sizeBefore: Int
+        let sizeAfter: Int
+        let symbolsBefore: Int
+        let symbolsAfter: Int
+    }
+
+    /// One __LINKEDIT blob and the load command fields pointing at it.
+    private struct Blob {
+        let offsetField: UnsafeMutablePointer<UInt32>
+        let offset: Int
+        var bytes: [UInt8]
+        /// Count or size field, rewritten when `bytes` is replaced.
+        var countField: UnsafeMutablePointer<UInt32>?
+        var count: UInt32
+        var alignment = 8
+    }
+
+    private static let linkeditDataCommands: Set<UInt32> = [
+        MachOLoadCommand.codeSignature,
+        0x1e, // LC_SEGMENT_SPLIT_INFO
+        0x26, // LC_FUNCTION_STARTS
+        0x29, // LC_DATA_IN_CODE
+        0x2b, // LC_DYLIB_CODE_SIGN_DRS
+        0x2e, // LC_LINKER_OPTIMIZATION_HINT
+        0x36, // LC_ATOM_INFO
+        MachOLoadCommand.dyldExportsTrie,
+        MachOLoadCommand.dyldChainedFixups,
+    ]
+
+    private static let indirectSymbolLocal: UInt32 = 0x80000000
+    private static let indirectSymbolAbs: UInt32 = 0x40000000
+
+    func slim(_ file: MappedFile) throws -> Result {
+        guard !file.isUniversal, let slice = try file.preferredARM64Slice() else {
+            throw MachOError("Only thin images can be slimmed")
+        }
+        guard let linkedit = slice.segment(named: "__LINKEDIT") else {
+            throw MachOError("No __LINKEDIT in \(file.path)")
+        }
+        guard let symtab = slice.firstCommand(MachOLoadCommand.symtab, as: symtab_command.self) else {
+            throw MachOError("No symbol table in \(file.path)")
+        }
+
+        let linkeditStart = Int(linkedit.pointee.fileoff)
+        let sizeBefore = file.size
+        guard linkeditStart + Int(linkedit.pointee.filesize) == file.size else {
+            throw MachOError("__LINKEDIT is not at the end of \(file.path)")
+        }
+
+        var blobs = try collectBlobs(in: slice, linkeditRange: linkeditStart..<file.size)
+        let symbolsBefore = Int(symtab.pointee.nsyms)
+        guard symbolsBefore > 0 else {
+            throw MachOError("\(file.path) has no symbols to strip")
+        }
+        let symbolsAfter = try rebuildSymbols(in: slice, symtab: symtab, blobs: &blobs)
+
+        // Pack the blobs in their original order; the signature stays last
+        blobs.sort { $0.offset < $1.offset }
+        var packed = ByteWriter()
+        for index in blobs.indices {
+            while packed.count % blobs[index].alignment != 0 { packed.u8(0) }
+            blobs[index].offsetField.pointee = UInt32(linkeditStart + packed.count)
+            blobs[index].countField?.pointee = blobs[index].count
+            packed.bytes += blobs[index].bytes
+        }
+        packed.align(8)
+        guard packed.count <= sizeBefore - linkeditStart else {
+            throw MachOError("Slimmed __LINKEDIT of \(file.path) would grow")
+        }
+
+        let pageMask: UInt64 = 0x3fff
+        linkedit.pointee.filesize = UInt64(packed.count)
+        linkedit.pointee.vmsize = (UInt64(packed.count) + pageMask) & ~pageMask
+
+        packed.bytes.withUnsafeBytes { slice.base.advanced(by: linkeditStart).copyMemory(from: $0.baseAddress!, byteCount: $0.count) }
+        try file.resize(to: linkeditStart + packed.count)
+
+        return Result(sizeBefore: sizeBefore, sizeAfter: file.size, symbolsBefore: symbolsBefore, symbolsAfter: symbolsAfter)
+    }
+
+    // MARK: - Blobs
+
+    private func collectBlobs(in slice: MachOSlice, linkeditRange: Range<Int>) throws -> [Blob] {
+        var blobs: [Blob] = []
+
+        func add(_ offsetField: UnsafeMutablePointer<UInt32>, size: Int, countField: UnsafeMutablePointer<UInt32>? = nil, alignment: Int = 8) throws {
+            let offset = Int(offsetField.pointee)
+            guard offset != 0, size > 0 else { return }
+            guard linkeditRange.contains(offset), offset + size <= linkeditRange.upperBound else {
+                throw MachOError("A load command points outside __LINKEDIT")
+            }
+
+            let bytes = Array(UnsafeRawBufferPointer(start: slice.base.advanced(by: offset), count: size))
+            blobs.append(Blob(offsetField: offsetField, offset: offset, bytes: bytes, countField: countField, count: countField?.pointee ?? 0, alignment: alignment))
+        }
+
+        try slice.forEachLoadCommand { command, _ in
+            let raw = UnsafeMutableRawPointer(command)
+            let field = { (index: Int) in raw.advanced(by: 8 + index * 4).assumingMemoryBound(to: UInt32.self) }
+
+            switch command.pointee.cmd {
+            case MachOLoadCommand.symtab:
+                // symoff, nsyms, stroff, strsize
+                try add(field(0), size: Int(field(1).pointee) * MemoryLayout<nlist_64>.size, countField: field(1))
+                try add(field(2), size: Int(field(3).pointee), countField: field(3))
+
+            case MachOLoadCommand.dysymtab:
+                // tocoff/ntoc, modtaboff/nmodtab, extrefsymoff/nextrefsyms,
+                // indirectsymoff/nindirectsyms, extreloff/nextrel, locreloff/nlocrel
+                for (index, entrySize) in [(6, 8), (8, 56), (10, 4), (12, 4), (14, 8), (16, 8)] {
+                    try add(field(index), size: Int(field(index + 1).pointee) * entrySize, countField: field(index + 1))
+                }
+
+            case MachOLoadCommand.dyldInfo, MachOLoadCommand.dyldInfoOnly:
+                // rebase, bind, weak bind, lazy bind, export: offset then size each
+                for index in stride(from: 0, to: 10, by: 2) {
+                    try add(field(index), size: Int(field(index + 1).pointee), countField: field(index + 1))
+                }
+
+            case let cmd where Self.linkeditDataCommands.contains(cmd):
+                try add(field(0), size: Int(field(1).pointee), countField: field(1), alignment: cmd == MachOLoadCommand.codeSignature ? 16 : 8)
+
+            default:
+                break
+            }
+            return true
+        }
+
+        return blobs
+    }
+
+    // MARK: - Symbols
+
+    /// Replaces the symbol table, string table and every table indexing the
+    /// symbols with slimmed copies. Returns the new symbol count.
+    private func rebuildSymbols(in slice: MachOSlice, symtab: UnsafeMutablePointer<symtab_command>, blobs: inout [Blob]) throws -> Int {
+        guard let dysymtab = slice.firstCommand(MachOLoadCommand.dysymtab, as: dysymtab_command.self) else {
+            throw MachOError("No LC_DYSYMTAB to renumber")
+        }
+        guard dysymtab.pointee.ntoc == 0, dysymtab.pointee.nmodtab == 0 else {
+            throw MachOError("Images with a table of contents or module table can't be slimmed")
+        }
+
+        let symbolCount = Int(symtab.pointee.nsyms)
+        let symbols = UnsafeBufferPointer(
+            start: UnsafeRawPointer(slice.base.advanced(by: Int(symtab.pointee.symoff))).assumingMemoryBound(to: nlist_64.self),
+            count: symbolCount
+        )
+        let strings = UnsafeRawBufferPointer(start: slice.base.advanced(by: Int(symtab.pointee.stroff)), count: Int(symtab.pointee.strsize))
+
+        let externals = Int(dysymtab.pointee.iextdefsym)..<Int(dysymtab.pointee.iextdefsym + dysymtab.pointee.nextdefsym)
+        let undefineds = Int(dysymtab.pointee.iundefsym)..<Int(dysymtab.pointee.iundefsym + dysymtab.pointee.nundefsym)
+        guard externals.upperBound <= symbolCount, undefineds.upperBound <= symbolCount else {
+            throw MachOError("LC_DYSYMTAB ranges run past the symbol table")
+        }
+
+        // Old index to new, for the symbols that stay
+        var newIndex = [UInt32](repeating: UInt32.max, count: symbolCount)
+        var table = ByteWriter()
+        var stringPool = ByteWriter()
+        stringPool.bytes = [0x20, 0]
+        var pooled: [Int: UInt32] = [:]
+        var kept: UInt32 = 0
+
+        for index in Array(externals) + Array(undefineds) {
+            var symbol = symbols[index]
+            guard Int32(symbol.n_type) & N_STAB == 0 else { continue }
+
+            let nameOffset = Int(symbol.n_un.n_strx)
+            if nameOffset > 0, nameOffset < strings.count {
+                if let existing = pooled[nameOffset] {
+                    symbol.n_un.n_strx = existing
+                } else {
+                    let name = strings[nameOffset...].prefix { $0 != 0 }
+                    let offset = UInt32(stringPool.count)
+                    stringPool.bytes += name
+                    stringPool.u8(0)
+                    pooled[nameOffset] = offset
+                    symbol.n_un.n_strx = offset
+                }
+            } else {
+                symbol.n_un.n_strx = 0
+            }
+
+            withUnsafeBytes(of: symbol) { table.bytes += $0 }
+            newIndex[index] = kept
+            kept += 1
+        }
+        stringPool.align(8)
+
+        let keptExternals = UInt32(externals.filter { newIndex[$0] != UInt32.max }.count)
+        let keptUndefineds = kept - keptExternals
+
+        for index in blobs.indices {
+            let offset = blobs[index].offset
+            if offset == Int(symtab.pointee.symoff) {
+                blobs[index].bytes = table.bytes
+                blobs[index].count = kept
+            } else if offset == Int(symtab.pointee.stroff) {
+                blobs[index].bytes = stringPool.bytes
+                blobs[index].count = UInt32(stringPool.count)
+            } else if offset == Int(dysymtab.pointee.indirectsymoff) {
+                blobs[index].bytes = renumberIndirect(blobs[index].bytes, newIndex)
+            } else if offset == Int(dysymtab.pointee.extreloff) {
+                blobs[index].bytes = try renumberRelocations(blobs[index].bytes, newIndex)
+            }
+        }
+
+        // Old two-level namespace data that nothing reads any more
+        if dysymtab.pointee.nextrefsyms > 0 {
+            blobs.removeAll { $0.offset == Int(dysymtab.pointee.extrefsymoff) }
+            dysymtab.pointee.extrefsymoff = 0
+            dysymtab.pointee.nextrefsyms = 0
+        }
+
+        dysymtab.pointee.ilocalsym = 0
+        dysymtab.pointee.nlocalsym = 0
+        dysymtab.pointee.iextdefsym = 0
+        dysymtab.pointee.nextdefsym = keptExternals
+        dysymtab.pointee.iundefsym = keptExternals
+        dysymtab.pointee.nundefsym = keptUndefineds
+
+        return Int(kept)
+    }
+
+    /// Entries pointing at a dropped symbol become INDIRECT_SYMBOL_LOCAL; such
+    /// pointers are rebased rather than bound, so dyld never looks them up.
+    private func renumberIndirect(_ bytes: [UInt8], _ newIndex: [UInt32]) -> [UInt8] {
+        var bytes = bytes
+        bytes.withUnsafeMutableBytes { raw in
+            for offset in stride(from: 0, to: raw.count, by: 4) {
+                let entry = raw.load(fromByteOffset: offset, as: UInt32.self)
+                guard entry & (Self.indirectSymbolLocal | Self.indirectSymbolAbs) == 0 else { continue }
+
+                let index = Int(entry)
+                let renumbered = index < newIndex.count && newIndex[index] != UInt32.max ? newIndex[index] : Self.indirectSymbolLocal
+                raw.storeBytes(of: renumbered, toByteOffset: offset, as: UInt32.self)
+            }
+        }
+        return bytes
+    }
+
+    /// External relocations name undefined symbols by index in the low 24
+    /// bits of their second word (r_symbolnum), with r_extern at bit 27.
+    private func renumberRelocations(_ bytes: [UInt8], _ newIndex: [UInt32]) throws -> [UInt8] {
+        var bytes = bytes
+        try bytes.withUnsafeMutableBytes { raw in
+            for offset in stride(from: 4, to: raw.count, by: 8) {
+                let info = raw.load(fromByteOffset: offset, as: UInt32.self)
+                guard info & 1 << 27 != 0 else { continue }
+
+                let index = Int(info & 0xff_ffff)
+                guard index < newIndex.count, newIndex[index] != UInt32.max else {
+                    throw MachOError("External relocation refers to dropped symbol \(index)")
+                }
+                raw.storeBytes(of: info & ~0xff_ffff | newIndex[index], toByteOffset: offset, as: UInt32.self)
+            }
+        }
+        return bytes
+    }
+}
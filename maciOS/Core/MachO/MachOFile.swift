@@ -0,0 +1,504 @@
+//
+//  MachOFile.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+struct MachOError: Error, CustomStringConvertible {
+    let description: String
+    
+    init(_ description: String) {
+        self.description = description
+    }
+    
+    static func posix(_ action: String, _ path: String) -> MachOError {
+        MachOError("\(action) \(path): \(String(cString: strerror(errno)))")
+    }
+}
+
+/// Load commands that the MachO module either doesn't import or imports with
+/// an awkward type. Keeping them in one place avoids the ad-hoc hex literals.
+enum MachOLoadCommand {
+    static let segment64: UInt32 = 0x19
+    static let symtab: UInt32 = 0x2
+    static let dysymtab: UInt32 = 0xb
+    static let unixThread: UInt32 = 0x5
+    static let loadDylib: UInt32 = 0xc
+    static let idDylib: UInt32 = 0xd
+    static let loadWeakDylib: UInt32 = 0x80000018
+    static let reexportDylib: UInt32 = 0x8000001f
+    static let lazyLoadDylib: UInt32 = 0x20
+    static let loadUpwardDylib: UInt32 = 0x80000023
+    static let rpath: UInt32 = 0x8000001c
+    static let codeSignature: UInt32 = 0x1d
+    static let dyldInfo: UInt32 = 0x22
+    static let dyldInfoOnly: UInt32 = 0x80000022
+    static let main: UInt32 = 0x80000028
+    static let buildVersion: UInt32 = 0x32
+    static let dyldExportsTrie: UInt32 = 0x80000033
+    static let dyldChainedFixups: UInt32 = 0x80000034
+    /// Placeholder used while the libc++ load command is parked (see `handleDylibCommands`).
+    static let parkedDylib: UInt32 = 0x114514
+    
+    static let dylibLoads: Set<UInt32> = [loadDylib, loadWeakDylib, reexportDylib, lazyLoadDylib, loadUpwardDylib]
+}
+
+/// The kinds of image the patcher knows how to turn into something dlopen-able.
+enum MachOImageKind: String, Codable {
+    case executable
+    case dylib
+    case bundle
+    
+    init?(filetype: UInt32) {
+        switch filetype {
+        case UInt32(MH_EXECUTE): self = .executable
+        case UInt32(MH_DYLIB): self = .dylib
+        case UInt32(MH_BUNDLE): self = .bundle
+        default: return nil
+        }
+    }
+}
+
+/// Returns the string stored in a fixed-size `char[16]` Mach-O name field.
+func machOName<T>(_ field: T) -> String {
+    withUnsafeBytes(of: field) { raw in
+        String(decoding: raw.prefix { $0 != 0 }, as: UTF8.self)
+    }
+}
+
+/// Compares a fixed-size Mach-O name field against `name` without allocating.
+func machONameEquals<T>(_ field: T, _ name: StaticString) -> Bool {
+    withUnsafeBytes(of: field) { raw in
+        let length = name.utf8CodeUnitCount
+        guard length <= raw.count else { return false }
+        if length < raw.count && raw[length] != 0 { return false }
+        return memcmp(raw.baseAddress!, name.utf8Start, length) == 0
+    }
+}
+
+/// Size and modification time of a file. Caches of parsed images compare
+/// these to notice when the patcher has rewritten a file in place.
+struct FileStamp: Equatable, Codable {
+    let size: Int64
+    let seconds: Int
+    let nanoseconds: Int
+    
+    init?(path: String) {
+        var info = stat()
+        guard stat(path, &info) == 0 else { return nil }
+        
+        size = Int64(info.st_size)
+        seconds = info.st_mtimespec.tv_sec
+        nanoseconds = info.st_mtimespec.tv_nsec
+    }
+}
+
+/// A whole file mapped with MAP_SHARED. Edits made through `base` go straight
+/// to the page cache, so only the pages that are actually touched get written
+/// back - no `Data` round trips.
+final class MappedFile {
+    let path: String
+    let writable: Bool
+    private(set) var fd: Int32
+    private(set) var base: UnsafeMutableRawPointer
+    private(set) var size: Int
+    
+    init(path: String, writable: Bool = true) throws {
+        self.path = path
+        self.writable = writable
+        
+        fd = open(path, writable ? O_RDWR : O_RDONLY)
+        guard fd >= 0 else {
+            throw MachOError.posix("Failed to open", path)
+        }
+        
+        var fileStat = stat()
+        guard fstat(fd, &fileStat) == 0 else {
+            let error = MachOError.posix("Failed to stat", path)
+            close(fd)
+            throw error
+        }
+        
+        size = Int(fileStat.st_size)
+        guard size >= MemoryLayout<mach_header_64>.size else {
+            close(fd)
+            throw MachOError("File too small to be a Mach-O: \(path)")
+        }
+        
+        let prot = writable ? PROT_READ | PROT_WRITE : PROT_READ
+        guard let map = mmap(nil, size, prot, MAP_SHARED, fd, 0), map != MAP_FAILED else {
+            let error = MachOError.posix("Failed to map", path)
+            close(fd)
+            throw error
+        }
+        base = map
+    }
+    
+    deinit {
+        if writable {
+            msync(base, size, MS_SYNC)
+        }
+        munmap(base, size)
+        close(fd)
+    }
+    
+    func sync() {
+        guard writable else { return }
+        msync(base, size, MS_SYNC)
+    }
+    
+    /// Grows or shrinks the file and remaps it. Any pointers into the old
+    /// mapping are invalid afterwards, which is why `MachOSlice` only stores offsets.
+    ///
+    /// The new mapping is made before the file changes size and the old one
+    /// is only dropped once both have worked, so on any error the file and
+    /// `base`/`size` are left exactly as they were.
+    func resize(to newSize: Int) throws {
+        guard writable else { throw MachOError("\(path) is mapped read-only") }
+        
+        msync(base, size, MS_SYNC)
+        
+        // Mapping past the end of the file is allowed; only touching those pages isn't
+        guard let map = mmap(nil, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0), map != MAP_FAILED else {
+            throw MachOError.posix("Failed to remap", path)
+        }
+        
+        guard ftruncate(fd, off_t(newSize)) == 0 else {
+            let error = MachOError.posix("Failed to resize", path)
+            munmap(map, newSize)
+            throw error
+        }
+        
+        munmap(base, size)
+        base = map
+        size = newSize
+    }
+    
+    var isUniversal: Bool {
+        base.load(as: UInt32.self) != MH_MAGIC_64
+    }
+    
+    /// Whether the host process runs arm64e code, in which case an arm64e guest
+    /// slice is preferred; a plain arm64 process can't load arm64e images.
+    static let hostIsARM64E: Bool = {
+        guard let header = _dyld_get_image_header(0) else { return false }
+        return UInt32(bitPattern: header.pointee.cpusubtype) & 0x00ffffff == UInt32(CPU_SUBTYPE_ARM64E)
+    }()
+    
+    /// The arm64 slice the host can actually load: arm64e for an arm64e host,
+    /// otherwise plain arm64, falling back to whatever arm64 flavour exists.
+    func preferredARM64Slice() throws -> MachOSlice? {
+        let candidates = try slices().filter { $0.cputype == CPU_TYPE_ARM64 }
+        let preferred = candidates.first { $0.isARM64E == Self.hostIsARM64E }
+        
+        if preferred == nil, let fallback = candidates.first {
+            NSLog("No \(Self.hostIsARM64E ? "arm64e" : "arm64") slice in \(path), using \(fallback.isARM64E ? "arm64e" : "arm64")")
+            return fallback
+        }
+        return preferred
+    }
+    
+    /// Every 64-bit Mach-O image in the file; a thin file yields one slice.
+    func slices() throws -> [MachOSlice] {
+        let magic = base.load(as: UInt32.self)
+        
+        switch magic {
+        case MH_MAGIC_64:
+            return [MachOSlice(file: self, offset: 0, size: size)]
+        
+        case FAT_MAGIC, FAT_CIGAM, FAT_MAGIC_64, FAT_CIGAM_64:
+            let is64 = magic == FAT_MAGIC_64 || magic == FAT_CIGAM_64
+            let count = Int(UInt32(bigEndian: base.load(fromByteOffset: 4, as: UInt32.self)))
+            let archSize = is64 ? MemoryLayout<fat_arch_64>.size : MemoryLayout<fat_arch>.size
+            var slices: [MachOSlice] = []
+            
+            for i in 0..<count {
+                let archOffset = MemoryLayout<fat_header>.size + i * archSize
+                guard archOffset + archSize <= size else {
+                    throw MachOError("Truncated fat header in \(path)")
+                }
+                
+                let offset: Int
+                let sliceSize: Int
+                if is64 {
+                    let arch = base.loadUnaligned(fromByteOffset: archOffset, as: fat_arch_64.self)
+                    offset = Int(UInt64(bigEndian: arch.offset))
+                    sliceSize = Int(UInt64(bigEndian: arch.size))
+                } else {
+                    let arch = base.loadUnaligned(fromByteOffset: archOffset, as: fat_arch.self)
+                    offset = Int(UInt32(bigEndian: arch.offset))
+                    sliceSize = Int(UInt32(bigEndian: arch.size))
+                }
+                
+                guard offset + sliceSize <= size else {
+                    throw MachOError("Slice \(i) lies outside \(path)")
+                }
+                
+                // 32-bit slices can't be loaded on iOS, skip them rather than fail.
+                if base.load(fromByteOffset: offset, as: UInt32.self) == MH_MAGIC_64 {
+                    slices.append(MachOSlice(file: self, offset: offset, size: sliceSize))
+                }
+            }
+            return slices
+        
+        default:
+            throw MachOError("Not a Mach-O file (magic \(String(format: "%08x", magic)))")
+        }
+    }
+}
+
+/// A single 64-bit image inside a `MappedFile`. Only offsets are stored so the
+/// slice stays valid across `MappedFile.resize(to:)`.
+struct MachOSlice {
+    let file: MappedFile
+    let offset: Int
+    let size: Int
+    
+    var base: UnsafeMutableRawPointer {
+        file.base.advanced(by: offset)
+    }
+    
+    var header: UnsafeMutablePointer<mach_header_64> {
+        base.assumingMemoryBound(to: mach_header_64.self)
+    }
+    
+    var cputype: cpu_type_t {
+        header.pointee.cputype
+    }
+    
+    var cpusubtype: cpu_subtype_t {
+        header.pointee.cpusubtype
+    }
+    
+    /// The ptrauth ABI version lives in the top byte of the subtype, so mask it off.
+    var isARM64E: Bool {
+        cputype == CPU_TYPE_ARM64 && UInt32(bitPattern: cpusubtype) & 0x00ffffff == UInt32(CPU_SUBTYPE_ARM64E)
+    }
+    
+    var loadCommandsOffset: Int {
+        MemoryLayout<mach_header_64>.size
+    }
+    
+    /// Calls `body` with each load command and its offset from the start of the
+    /// slice. Returning `false` stops the walk.
+    func forEachLoadCommand(_ body: (UnsafeMutablePointer<load_command>, Int) throws -> Bool) rethrows {
+        let ncmds = Int(header.pointee.ncmds)
+        let end = loadCommandsOffset + Int(header.pointee.sizeofcmds)
+        var cmdOffset = loadCommandsOffset
+        
+        for _ in 0..<ncmds {
+            guard cmdOffset + MemoryLayout<load_command>.size <= min(end, size) else { return }
+            
+            let command = base.advanced(by: cmdOffset).assumingMemoryBound(to: load_command.self)
+            let cmdsize = Int(command.pointee.cmdsize)
+            guard cmdsize >= MemoryLayout<load_command>.size else { return }
+            
+            guard try body(command, cmdOffset) else { return }
+            cmdOffset += cmdsize
+        }
+    }
+    
+    func firstCommand<T>(_ cmd: UInt32, as type: T.Type) -> UnsafeMutablePointer<T>? {
+        var found: UnsafeMutablePointer<T>?
+        forEachLoadCommand { command, _ in
+            if command.pointee.cmd == cmd {
+                found = UnsafeMutableRawPointer(command).assumingMemoryBound(to: T.self)
+                return false
+            }
+            return true
+        }
+        return found
+    }
+    
+    func segment(named name: StaticString) -> UnsafeMutablePointer<segment_command_64>? {
+        var found: UnsafeMutablePointer<segment_command_64>?
+        forEachLoadCommand { command, _ in
+            if command.pointee.cmd == MachOLoadCommand.segment64 {
+                let segment = UnsafeMutableRawPointer(command).assumingMemoryBound(to: segment_command_64.self)
+                if machONameEquals(segment.pointee.segname, name) {
+                    found = segment
+                    return false
+                }
+            }
+            return true
+        }
+        return found
+    }
+    
+    func sections(of segment: UnsafeMutablePointer<segment_command_64>) -> UnsafeMutableBufferPointer<section_64> {
+        let first = UnsafeMutableRawPointer(segment)
+            .advanced(by: MemoryLayout<segment_command_64>.size)
+            .assumingMemoryBound(to: section_64.self)
+        return UnsafeMutableBufferPointer(start: first, count: Int(segment.pointee.nsects))
+    }
+    
+    /// Padding between the end of the load commands and the first byte of
+    /// segment or section contents, i.e. how far the commands may grow in place.
+    var loadCommandsFreeSpace: Int {
+        var firstContent = size
+        
+        forEachLoadCommand { command, _ in
+            guard command.pointee.cmd == MachOLoadCommand.segment64 else { return true }
+            
+            let segment = UnsafeMutableRawPointer(command).assumingMemoryBound(to: segment_command_64.self)
+            if segment.pointee.fileoff > 0 && segment.pointee.filesize > 0 {
+                firstContent = min(firstContent, Int(segment.pointee.fileoff))
+            }
+            
+            for section in sections(of: segment) where section.offset > 0 && section.size > 0 {
+                firstContent = min(firstContent, Int(section.offset))
+            }
+            return true
+        }
+        
+        return firstContent - (loadCommandsOffset + Int(header.pointee.sizeofcmds))
+    }
+    
+    func section(_ segmentName: StaticString, _ sectionName: StaticString) -> UnsafeMutablePointer<section_64>? {
+        guard let segment = segment(named: segmentName) else { return nil }
+        let sections = sections(of: segment)
+        
+        for i in 0..<sections.count where machONameEquals(sections[i].sectname, sectionName) {
+            return sections.baseAddress!.advanced(by: i)
+        }
+        return nil
+    }
+    
+    /// The file bytes backing a section, or nil for zerofill/out-of-range sections.
+    func contents(of section: UnsafeMutablePointer<section_64>) -> UnsafeMutableRawBufferPointer? {
+        let start = Int(section.pointee.offset)
+        let length = Int(section.pointee.size)
+        let type = section.pointee.flags & UInt32(SECTION_TYPE)
+        
+        guard start > 0, length > 0, start + length <= size,
+              type != UInt32(S_ZEROFILL), type != UInt32(S_GB_ZEROFILL), type != UInt32(S_THREAD_LOCAL_ZEROFILL) else {
+            return nil
+        }
+        return UnsafeMutableRawBufferPointer(start: base.advanced(by: start), count: length)
+    }
+    
+    /// Install names of the dylib load commands in order; a bind's library
+    /// ordinal N refers to element N - 1.
+    var dylibLoadNames: [String] {
+        var names: [String] = []
+        forEachLoadCommand { command, _ in
+            if MachOLoadCommand.dylibLoads.contains(command.pointee.cmd) {
+                names.append(dylibName(command) ?? "")
+            }
+            return true
+        }
+        return names
+    }
+    
+    /// Undefined symbols from the symbol table, with their `n_desc` (library
+    /// ordinal and weak flag). Empty without LC_SYMTAB and LC_DYSYMTAB.
+    func undefinedSymbols() -> [(name: String, desc: UInt16)] {
+        guard let symtab = firstCommand(MachOLoadCommand.symtab, as: symtab_command.self),
+              let dysymtab = firstCommand(MachOLoadCommand.dysymtab, as: dysymtab_command.self),
+              Int(symtab.pointee.symoff) + Int(symtab.pointee.nsyms) * MemoryLayout<nlist_64>.size <= size,
+              Int(symtab.pointee.stroff) + Int(symtab.pointee.strsize) <= size else {
+            return []
+        }
+        
+        let stringTable = UnsafePointer(base.advanced(by: Int(symtab.pointee.stroff)).assumingMemoryBound(to: CChar.self))
+        let stringTableSize = Int(symtab.pointee.strsize)
+        let symbols = UnsafeBufferPointer(
+            start: UnsafeRawPointer(base.advanced(by: Int(symtab.pointee.symoff))).assumingMemoryBound(to: nlist_64.self),
+            count: Int(symtab.pointee.nsyms)
+        )
+        
+        let first = Int(dysymtab.pointee.iundefsym)
+        let undefined = min(symbols.count, first)..<min(symbols.count, first + Int(dysymtab.pointee.nundefsym))
+        
+        return undefined.compactMap { i in
+            let nameOffset = Int(symbols[i].n_un.n_strx)
+            guard nameOffset > 0, nameOffset < stringTableSize else { return nil }
+            return (String(cString: stringTable + nameOffset), symbols[i].n_desc)
+        }
+    }
+    
+    /// Appends a load command in the header padding, giving up expendable
+    /// commands if needed (see `HeaderSpace`). `command` must already be
+    /// padded to a multiple of 8 bytes.
+    @discardableResult
+    func appendLoadCommand(_ command: [UInt8]) -> Bool {
+        let space = HeaderSpace(self)
+        do {
+            try space.reserve(command.count)
+            try space.insert(command)
+            return true
+        } catch {
+            NSLog("Can't add a \(command.count) byte load command: \(error)")
+            return false
+        }
+    }
+    
+    /// Whether `appendingToLinkedit` can grow this slice.
+    var canAppendToLinkedit: Bool {
+        guard offset == 0, size == file.size, let linkedit = segment(named: "__LINKEDIT") else { return false }
+        return Int(linkedit.pointee.fileoff + linkedit.pointee.filesize) == file.size
+    }
+    
+    /// Writes `bytes` at the end of the file, 8-byte aligned, and grows
+    /// __LINKEDIT to cover them. Only possible when __LINKEDIT is the last
+    /// thing in a thin file. Returns the slice over the grown file and where
+    /// the bytes went; the caller points its load command there.
+    func appendingToLinkedit(_ bytes: [UInt8]) throws -> (slice: MachOSlice, offset: Int) {
+        guard offset == 0, size == file.size else {
+            throw MachOError("__LINKEDIT can only grow in a thin image")
+        }
+        guard let linkedit = segment(named: "__LINKEDIT"),
+              Int(linkedit.pointee.fileoff + linkedit.pointee.filesize) == file.size else {
+            throw MachOError("__LINKEDIT is not at the end of the image")
+        }
+        
+        let linkeditOffset = base.distance(to: UnsafeMutableRawPointer(linkedit))
+        let newOffset = (file.size + 7) & ~7
+        try file.resize(to: newOffset + bytes.count)
+        let slice = MachOSlice(file: file, offset: 0, size: file.size)
+        
+        bytes.withUnsafeBytes { slice.base.advanced(by: newOffset).copyMemory(from: $0.baseAddress!, byteCount: $0.count) }
+        
+        let segment = slice.base.advanced(by: linkeditOffset).assumingMemoryBound(to: segment_command_64.self)
+        segment.pointee.filesize = UInt64(file.size) - segment.pointee.fileoff
+        let pageMask: UInt64 = 0x3fff
+        segment.pointee.vmsize = max(segment.pointee.vmsize, (segment.pointee.filesize + pageMask) & ~pageMask)
+        
+        return (slice, newOffset)
+    }
+    
+    /// Bytes of a dylib_command for `path`, ready for `appendLoadCommand`.
+    static func dylibCommand(_ cmd: UInt32, path: String) -> [UInt8] {
+        let nameOffset = MemoryLayout<dylib_command>.size
+        let size = (nameOffset + path.utf8.count + 1 + 7) & ~7
+        var bytes = [UInt8](repeating: 0, count: size)
+        
+        bytes.withUnsafeMutableBytes { raw in
+            raw.storeBytes(of: cmd, toByteOffset: 0, as: UInt32.self)
+            raw.storeBytes(of: UInt32(size), toByteOffset: 4, as: UInt32.self)
+            raw.storeBytes(of: UInt32(nameOffset), toByteOffset: 8, as: UInt32.self)
+            raw.storeBytes(of: UInt32(2), toByteOffset: 12, as: UInt32.self)
+            raw.storeBytes(of: UInt32(0x10000), toByteOffset: 16, as: UInt32.self)
+            raw.storeBytes(of: UInt32(0x10000), toByteOffset: 20, as: UInt32.self)
+        }
+        bytes.replaceSubrange(nameOffset..<nameOffset + path.utf8.count, with: path.utf8)
+        return bytes
+    }
+    
+    /// Reads the NUL-terminated path stored in a dylib-style load command.
+    /// Also works for LC_RPATH, whose lc_str sits at the same offset.
+    func dylibName(_ command: UnsafeMutablePointer<load_command>) -> String? {
+        let dylib = UnsafeMutableRawPointer(command).assumingMemoryBound(to: dylib_command.self)
+        let nameOffset = Int(dylib.pointee.dylib.name.offset)
+        let cmdsize = Int(command.pointee.cmdsize)
+        guard nameOffset >= MemoryLayout<rpath_command>.size, nameOffset < cmdsize else { return nil }
+        
+        let name = UnsafeRawBufferPointer(start: UnsafeRawPointer(command).advanced(by: nameOffset), count: cmdsize - nameOffset)
+        return String(decoding: name.prefix { $0 != 0 }, as: UTF8.self)
+    }
+}
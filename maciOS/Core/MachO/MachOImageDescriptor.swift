@@ -0,0 +1,166 @@
+//
+//  MachOImageDescriptor.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Everything launching needs to know about an image, read in one pass over
+/// its mapped load commands: which slice to use, where __TEXT expects to be,
+/// the entry point and stack size, the libraries it loads and where its
+/// symbol table lives.
+///
+/// The patcher saves the descriptor next to the patched image as
+/// `<image>.descriptor`, so `Execute` reads a few hundred bytes of JSON instead
+/// of the image. The saved copy is only used while the image's size and
+/// modification time match; otherwise the image is parsed again.
+struct MachOImageDescriptor: Codable {
+    enum EntryKind: String, Codable {
+        /// LC_MAIN
+        case main
+        /// LC_UNIXTHREAD, from the pc of its ARM_THREAD_STATE64
+        case unixThread
+    }
+
+    struct SymbolTable: Codable {
+        let symbolOffset: UInt32
+        let symbolCount: UInt32
+        let stringOffset: UInt32
+        let stringSize: UInt32
+    }
+
+    /// Bump whenever what gets saved changes.
+    static let version = 1
+
+    let version: Int
+    let stamp: FileStamp
+    /// File offset of the slice; 0 for a thin image.
+    let sliceOffset: Int
+    let cputype: cpu_type_t
+    let cpusubtype: cpu_subtype_t
+    let fileType: UInt32
+    let textVMAddr: UInt64
+    let entryKind: EntryKind?
+    /// Offset of the entry point from the start of __TEXT.
+    let entryOffset: UInt64?
+    /// Requested by LC_MAIN; 0 means the default.
+    let stackSize: UInt64
+    /// Install names of every library the image loads, in ordinal order.
+    let dylibs: [String]
+    /// Offsets are from the start of the slice.
+    let symbolTable: SymbolTable?
+
+    init(_ slice: MachOSlice, stamp: FileStamp) throws {
+        guard let text = slice.segment(named: "__TEXT") else {
+            throw MachOError("No __TEXT segment in \(slice.file.path)")
+        }
+
+        var entryKind: EntryKind?
+        var entryAddress: UInt64?
+        var stackSize: UInt64 = 0
+        var dylibs: [String] = []
+        var symbolTable: SymbolTable?
+
+        slice.forEachLoadCommand { command, _ in
+            let raw = UnsafeRawPointer(command)
+
+            switch command.pointee.cmd {
+            case MachOLoadCommand.main:
+                let main = raw.assumingMemoryBound(to: entry_point_command.self).pointee
+                entryKind = .main
+                entryAddress = text.pointee.vmaddr + main.entryoff
+                stackSize = main.stacksize
+
+            case MachOLoadCommand.unixThread where entryKind == nil:
+                // flavor (ARM_THREAD_STATE64 is 6), count, then x0-x28, fp, lr, sp and pc
+                let pcOffset = 8 + 8 + 32 * 8
+                if Int(command.pointee.cmdsize) >= pcOffset + 8,
+                   raw.loadUnaligned(fromByteOffset: 8, as: UInt32.self) == 6 {
+                    entryKind = .unixThread
+                    entryAddress = raw.loadUnaligned(fromByteOffset: pcOffset, as: UInt64.self)
+                }
+
+            case MachOLoadCommand.symtab:
+                let symtab = raw.assumingMemoryBound(to: symtab_command.self).pointee
+                symbolTable = SymbolTable(symbolOffset: symtab.symoff, symbolCount: symtab.nsyms, stringOffset: symtab.stroff, stringSize: symtab.strsize)
+
+            case let cmd where MachOLoadCommand.dylibLoads.contains(cmd):
+                dylibs.append(slice.dylibName(command) ?? "")
+
+            default:
+                break
+            }
+            return true
+        }
+
+        version = Self.version
+        self.stamp = stamp
+        sliceOffset = slice.offset
+        cputype = slice.cputype
+        cpusubtype = slice.cpusubtype
+        fileType = slice.header.pointee.filetype
+        textVMAddr = text.pointee.vmaddr
+        self.entryKind = entryKind
+        entryOffset = entryAddress.flatMap { $0 >= textVMAddr ? $0 - textVMAddr : nil }
+        self.stackSize = stackSize
+        self.dylibs = dylibs
+        self.symbolTable = symbolTable
+    }
+
+    static func fileURL(for path: String) -> URL {
+        URL(fileURLWithPath: path + ".descriptor")
+    }
+
+    /// The descriptor of the image at `path`: the saved one when it is still
+    /// current, otherwise a fresh parse, which is then saved for next time.
+    static func load(_ path: String) -> MachOImageDescriptor? {
+        guard let stamp = FileStamp(path: path) else { return nil }
+
+        if let data = try? Data(contentsOf: fileURL(for: path)),
+           let saved = try? JSONDecoder().decode(MachOImageDescriptor.self, from: data),
+           saved.version == version, saved.stamp == stamp {
+            return saved
+        }
+
+        guard let descriptor = parse(path, stamp: stamp) else { return nil }
+        descriptor.save(beside: path)
+        return descriptor
+    }
+
+    /// Parses the image at `path` and saves its descriptor next to it. Call
+    /// once the image won't change any more.
+    @discardableResult
+    static func save(for path: String) -> Bool {
+        guard let stamp = FileStamp(path: path), let descriptor = parse(path, stamp: stamp) else { return false }
+        return descriptor.save(beside: path)
+    }
+
+    private static func parse(_ path: String, stamp: FileStamp) -> MachOImageDescriptor? {
+        do {
+            let file = try MappedFile(path: path, writable: false)
+            guard let slice = try file.preferredARM64Slice() else {
+                NSLog("No arm64 slice in \((path as NSString).lastPathComponent)")
+                return nil
+            }
+            return try MachOImageDescriptor(slice, stamp: stamp)
+        } catch {
+            NSLog("Error reading \((path as NSString).lastPathComponent): \(error)")
+            return nil
+        }
+    }
+
+    @discardableResult
+    private func save(beside path: String) -> Bool {
+        do {
+            try JSONEncoder().encode(self).write(to: Self.fileURL(for: path), options: .atomic)
+            return true
+        } catch {
+            NSLog("Error saving descriptor of \((path as NSString).lastPathComponent): \(error)")
+            return false
+        }
+    }
+}
@@ -5,6 +5,7 @@
 //  Created by Stossy11 on 22/08/2025.
 //
 
+import CryptoKit
 import Darwin
 import Foundation
 import MachO
@@ -18,382 +19,586 @@ class MachOPatcher: Equatable {
     
     var fileURL: URL
     var patchedURL: URL
-    var knownFrameworks: [(String, String)] {
-       return [
-            ("/usr/lib/libpcre.0.dylib", "@rpath/libpcre.1.dylib"),
-            ("/opt/homebrew/opt/pcre2/lib/libpcre2-32.0.dylib", "@rpath/libpcre.1.dylib"),
-            ("/usr/lib/libSystem.B.dylib", "@rpath/LIBSYSTEM.dylib"),
-            ("/System/Library/PrivateFrameworks/AuthKit.framework/Versions/A/AuthKit", "/System/Library/PrivateFrameworks/AuthKit.framework/AuthKit"),
-            ("/System/Library/PrivateFrameworks/AOSKit.framework/Versions/A/AOSKit", "/System/Library/PrivateFrameworks/AOSKit.framework/AOSKit"),
-            ("/opt/homebrew/opt/ncurses/lib/libncursesw.6.dylib", "@rpath/libncursesw.6.dylib"),
-            ("/System/Library/Frameworks/Foundation.framework/Versions/C/Foundation", "@rpath/Foundation.dylib"),
-            ("/System/Library/Frameworks/CryptoKit.framework/Versions/A/CryptoKit", "/System/Library/Frameworks/CryptoKit.framework/CryptoKit"),
-            ("/System/Library/Frameworks/OpenCL.framework/Versions/A/OpenCL", "@executable_path/Frameworks/OpenCL.framework/OpenCL"),
-            ("/System/Library/Frameworks/CoreFoundation.framework/Versions/A/CoreFoundation", "/System/Library/Frameworks/CoreFoundation.framework/CoreFoundation"),
-            ("/System/Library/Frameworks/CoreServices.framework/Versions/A/CoreServices", "@rpath/CoreServices.dylib"),
-            ("/System/Library/Frameworks/Security.framework/Versions/A/Security", "/System/Library/Frameworks/Security.framework/Security"),
-            ("/System/Library/Frameworks/AVFoundation.framework/Versions/A/AVFoundation", "/System/Library/Frameworks/AVFoundation.framework/AVFoundation"),
-            ("/System/Library/Frameworks/Cocoa.framework/Versions/A/Cocoa", "@executable_path/Frameworks/Cocoa.framework/Cocoa"),
-            ("/System/Library/Frameworks/CoreAudio.framework/Versions/A/CoreAudio", "/System/Library/Frameworks/CoreAudio.framework/CoreAudio"),
-            ("/System/Library/Frameworks/CoreMedia.framework/Versions/A/CoreMedia", "/System/Library/Frameworks/CoreMedia.framework/CoreMedia"),
-            ("/System/Library/Frameworks/CoreVideo.framework/Versions/A/CoreVideo", "@rpath/CoreVideo.dylib"),
-            ("/System/Library/Frameworks/Kerberos.framework/Versions/A/Kerberos", "/System/Library/Frameworks/Kerberos.framework/Kerberos"),
-            ("/System/Library/Frameworks/IOBluetooth.framework/Versions/A/IOBluetooth", "@executable_path/Frameworks/IOBluetooth.framework/IOBluetooth"),
-            ("/System/Library/Frameworks/CoreBluetooth.framework/Versions/A/CoreBluetooth", "/System/Library/Frameworks/CoreBluetooth.framework/CoreBluetooth"),
-            ("/System/Library/Frameworks/IOKit.framework/Versions/A/IOKit", "@rpath/IOKit.dylib"),
-            ("/System/Library/Frameworks/Metal.framework/Versions/A/Metal", "/System/Library/Frameworks/Metal.framework/Metal"),
-            ("/System/Library/Frameworks/MetalKit.framework/Versions/A/MetalKit", "/System/Library/Frameworks/MetalKit.framework/MetalKit"),
-            ("System/Library/Frameworks/LocalAuthentication.framework/Versions/A/LocalAuthentication", "/System/Library/Frameworks/LocalAuthentication.framework/LocalAuthentication"),
-            ("/System/Library/Frameworks/CFNetwork.framework/Versions/A/CFNetwork", "/System/Library/Frameworks/CFNetwork.framework/CFNetwork"),
-            ("/System/Library/Frameworks/SystemConfiguration.framework/Versions/A/SystemConfiguration", "/System/Library/Frameworks/SystemConfiguration.framework/SystemConfiguration"),
-            ("/System/Library/Frameworks/CoreWLAN.framework/Versions/A/CoreWLAN", "@executable_path/Frameworks/CoreWLAN.framework/CoreWLAN"),
-            ("/System/Library/Frameworks/OpenGL.framework/Versions/A/OpenGL", "@rpath/CoreOpenGL.framework/CoreOpenGL"),
-            ("/System/Library/PrivateFrameworks/DisplayServices.framework/Versions/A/DisplayServices", "@executable_path/Frameworks/DisplayServices.framework/DisplayServices"),
-            ("/System/Library/Frameworks/AppKit.framework/Versions/C/AppKit", "@executable_path/Frameworks/AppKit_iOS.framework/AppKit_iOS"),
-            ("/System/Library/Frameworks/CoreGraphics.framework/Versions/A/CoreGraphics", "@rpath/CoreGraphics.dylib"),
-            ("/System/Library/Frameworks/SwiftUI.framework/Versions/A/SwiftUI", "/System/Library/Frameworks/SwiftUI.framework/SwiftUI"),
-            ("/System/Library/Frameworks/Combine.framework/Versions/A/Combine", "/System/Library/Frameworks/Combine.framework/Combine"),
-            ("/System/Library/Frameworks/WebKit.framework/Versions/A/WebKit", "/System/Library/Frameworks/WebKit.framework/WebKit"),
-        ]
-    }
+    /// Write only the arm64 slice of universal binaries, dropping the fat header
+    /// and every other architecture. On by default; `ThinUniversalBinaries` turns it off.
+    var thinUniversalBinaries = UserDefaults.standard.object(forKey: "ThinUniversalBinaries") as? Bool ?? true
+    /// Give patched images a fresh ad-hoc signature instead of relying on the
+    /// dyld hooks to ignore the stale one. Needs thin images. Off by default;
+    /// `AdHocSignPatchedImages` turns it on.
+    var adHocSign = UserDefaults.standard.bool(forKey: "AdHocSignPatchedImages")
+    /// Bind imports that nothing on iOS exports to a generated stub dylib placed
+    /// next to the image (see `StubDylibBuilder`). On by default;
+    /// `SynthesizeStubDylibs` turns it off.
+    var synthesizeStubs = UserDefaults.standard.object(forKey: "SynthesizeStubDylibs") as? Bool ?? true
+    /// Strip local symbols, debug stabs and unused tables from __LINKEDIT (see
+    /// `LinkeditSlimmer`). Needs thin images. Off by default; `SlimLinkedit`
+    /// turns it on.
+    var slimLinkedit = UserDefaults.standard.bool(forKey: "SlimLinkedit")
+    /// Per-app remap overrides are looked up under this name; defaults to the
+    /// input's file name without its extension.
+    lazy var appName = fileURL.deletingPathExtension().lastPathComponent
+    /// The bundled `FrameworkRemaps.rules` plus any overrides for `appName`.
+    lazy var remapRules = FrameworkRemapRules.load(for: appName)
+    
     
     init(_ path: URL) {
         self.fileURL = path
         self.patchedURL = URL.documentsDirectory.appendingPathComponent(fileURL.lastPathComponent + ".dylib")
     }
     
-    func patchExecutable() -> URL? {
-        guard copyOriginalFile() else { return nil }
-        
-        guard convertToDylib() != nil else { return nil }
-        
-        #if targetEnvironment(simulator)
-        guard patchPlatform(targetPlatform: PLATFORM_IOSSIMULATOR) != nil else { return nil }
-        #else
-        guard patchPlatform(targetPlatform: PLATFORM_IOS) != nil else { return nil }
-        #endif
-        
-        patchKnownFrameworks()
-        
-        return patchedURL
+    init(_ path: URL, patchedURL: URL) {
+        self.fileURL = path
+        self.patchedURL = patchedURL
     }
     
-    func patchKnownFrameworks(_ frameworks: [(String, String)] = []) {
-        let newFrameworks = knownFrameworks + frameworks
-        
-        newFrameworks.forEach { replacePattern($0.0, with: $0.1) }
+    #if targetEnvironment(simulator)
+    static let targetPlatform = UInt32(PLATFORM_IOSSIMULATOR)
+    #else
+    static let targetPlatform = UInt32(PLATFORM_IOS)
+    #endif
+    
+    /// Identifies the remap rules baked into a patched image; part of the cache key.
+    var ruleSetVersion: String {
+        var hasher = SHA256()
+        hasher.update(data: Data(remapRules.version.utf8))
+        hasher.update(data: Data("platform \(Self.targetPlatform) thin \(thinUniversalBinaries) sign \(adHocSign) slim \(slimLinkedit)".utf8))
+        hasher.update(data: Data("stubs \(synthesizeStubs ? StubDylibBuilder().configurationVersion : "off")".utf8))
+        return hasher.finalize().map { String(format: "%02x", $0) }.joined()
+    }
+    
+    /// Returns the patched image for `fileURL`, reusing the cached copy when the
+    /// same input was already patched with the same rules.
+    func patchExecutable() -> URL? {
+        guard let key = cacheKey() else { return nil }
+        return cachedImage(for: key) ?? patchIntoCache(key: key)
     }
     
-    private func copyOriginalFile() -> Bool {
+    /// The cache key for `fileURL`. Hashes the input the first time it's seen,
+    /// so this is the slow part of a cache hit.
+    func cacheKey() -> String? {
         do {
-            if FileManager.default.fileExists(atPath: patchedURL.path) {
-                try FileManager.default.removeItem(at: patchedURL)
-            }
-            let data = try Data(contentsOf: fileURL)
-            try data.write(to: patchedURL)
-            return true
+            return try PatchCache.shared.key(for: fileURL, ruleVersion: ruleSetVersion)
         } catch {
-            NSLog("Error copying file: \(error)")
-            return false 
+            NSLog("Error hashing \(fileURL.lastPathComponent): \(error)")
+            return nil
         }
     }
     
+    /// The cached image for `key`, adopted as `patchedURL` when there is one.
+    func cachedImage(for key: String) -> URL? {
+        guard let cached = PatchCache.shared.lookup(key, name: fileURL.lastPathComponent + ".dylib") else {
+            return nil
+        }
+        
+        NSLog("Using cached patched image for \(fileURL.lastPathComponent)")
+        patchedURL = cached
+        return cached
+    }
     
-    func patchPlatform(targetPlatform: Int32) -> String? {
-        if !FileManager.default.fileExists(atPath: patchedURL.path) {
-            do {
-                let data = try Data(contentsOf: fileURL)
-                try data.write(to: patchedURL)
-            } catch {
-                NSLog("Error copying file: \(error)")
+    /// Patches `fileURL` (or replays its recipe) into a staging directory and
+    /// publishes it as the cache entry for `key`.
+    func patchIntoCache(key: String) -> URL? {
+        let cache = PatchCache.shared
+        let name = fileURL.lastPathComponent + ".dylib"
+        
+        let staging: URL
+        do {
+            staging = try cache.makeStagingDirectory(for: key)
+        } catch {
+            NSLog("Error creating patch directory: \(error)")
+            return nil
+        }
+        
+        // Same file name as the final entry, so LC_ID_DYLIB doesn't change on publish
+        patchedURL = staging.appendingPathComponent(name)
+        
+        if let recipe = cache.recipe(for: key), replay(recipe) {
+            NSLog("Replayed patch recipe for \(fileURL.lastPathComponent) (\(recipe.edits.count) edits)")
+        } else {
+            guard patchCopy() else {
+                cache.discard(staging)
                 return nil
             }
+            recordRecipe(for: key)
         }
         
-        guard let patchedPath = performPlatformPatch(filePath: patchedURL.path, targetPlatform: UInt32(targetPlatform)) else {
-            return nil
-        }
+        // Saved beside the image, so launching it never has to parse it
+        MachOImageDescriptor.save(for: patchedURL.path)
         
-        return patchedPath
+        guard let entry = cache.store(staging, for: key) else { return nil }
+        patchedURL = entry.appendingPathComponent(name)
+        return patchedURL
     }
     
+    /// Patches `fileURL` straight into `patchedURL` without going through the
+    /// cache. Only executables are converted to dylibs; libraries and plugins
+    /// just get their platform and install names fixed. `additionalRemaps` are
+    /// exact rules applied on top of `remapRules`. With `finishing` false, the
+    /// steps that read other images or have to come last are left for
+    /// `finishPatch()`.
+    func patch(as kind: MachOImageKind, additionalRemaps: [(String, String)] = [], finishing: Bool = true) -> Bool {
+        patchCopy(kind: kind, rules: remapRules.adding(additionalRemaps), finishing: finishing)
+    }
     
-    func convertToDylib(doInject: Bool = true) -> String? {
-        if !FileManager.default.fileExists(atPath: patchedURL.path) {
-            do {
-                let data = try Data(contentsOf: fileURL)
-                try data.write(to: patchedURL)
-            } catch {
-                NSLog("Error copying file: \(error)")
-                return nil
-            }
+    /// Copies the original once, then maps the copy a single time and applies every
+    /// edit (dylib conversion, platform, framework remaps) before syncing it back.
+    private func patchCopy(kind: MachOImageKind = .executable, rules: FrameworkRemapRules? = nil, finishing: Bool = true) -> Bool {
+        guard copyOriginalFile() else { return false }
+        
+        // First, so the symbol table walks below only see what's left
+        if slimLinkedit {
+            slimPatchedLinkedit()
         }
         
-        let error = parseMachOFile(path: patchedURL.path) { [weak self] path, header, fd, filePtr in
-            if header.pointee.cputype == CPU_TYPE_ARM64 {
-                self?.patchExecSlice(path: path, header: header, doInject: doInject)
+        let rules = rules ?? remapRules
+        let remapper = DylibRemapper(rules)
+        let stringRemapper = FrameworkStringRemapper(rules)
+        var platformFound = false
+        let patched = withPatchedFile { file in
+            for slice in try file.slices() {
+                if slice.cputype == CPU_TYPE_ARM64 {
+                    remapper.remap(slice)
+                    if kind == .executable {
+                        patchExecSlice(slice, doInject: true)
+                    }
+                    stringRemapper.rewrite(slice)
+                }
+                
+                if patchPlatform(in: slice, targetPlatform: Self.targetPlatform) {
+                    platformFound = true
+                }
             }
         }
         
-        if let error = error {
-            NSLog("Error converting to dylib: \(error)")
-            return nil
+        guard patched else { return false }
+        
+        guard platformFound else {
+            NSLog("No LC_BUILD_VERSION found in any slice")
+            return false
         }
         
-        return patchedURL.path
+        return finishing ? finishPatch() : true
     }
     
-    
-    @discardableResult
-    func replacePattern(_ pattern: String, with replacement: String) -> Bool {
-        return replacePatternInPatchedFile(pattern: pattern, replacement: replacement)
+    /// Stubs missing symbols, signs and marks the patched copy executable.
+    /// Stubbing reads the libraries the image links, so a bundle runs this
+    /// only once every image in it has been patched.
+    func finishPatch() -> Bool {
+        if synthesizeStubs, !stubMissingSymbols() {
+            return false
+        }
+        
+        if adHocSign, !signPatchedImage() {
+            return false
+        }
+        
+        return setExecutablePermissions()
     }
     
-    
-    static func OSSwapInt32(_ value: UInt32) -> UInt32 {
-        return value.byteSwapped
+    /// Slimming is only an optimisation, so a failure is logged and patching goes on.
+    private func slimPatchedLinkedit() {
+        do {
+            let file = try MappedFile(path: patchedURL.path)
+            let result = try LinkeditSlimmer().slim(file)
+            file.sync()
+            NSLog("Slimmed \(fileURL.lastPathComponent): \(result.sizeBefore) -> \(result.sizeAfter) bytes, \(result.symbolsBefore) -> \(result.symbolsAfter) symbols")
+        } catch {
+            NSLog("Didn't slim __LINKEDIT of \(patchedURL.lastPathComponent): \(error)")
+        }
     }
     
-    static func OSSwapInt32(_ value: Int32) -> Int32 {
-        return value.byteSwapped
+    /// Stubs every import of the patched image that the library it binds to
+    /// doesn't export. Missing libraries are left for preflight to report.
+    /// Returns false when the imports couldn't be redirected, which fails the
+    /// patch rather than leaving an image that half binds to the stubs.
+    private func stubMissingSymbols() -> Bool {
+        let report = DependencyAnalyzer().analyze(patchedURL)
+        guard let root = report.images.first else { return true }
+        
+        let missing = report.missingSymbols.filter { $0.requiredBy == root }.map(\.name)
+        guard !missing.isEmpty else { return true }
+        
+        guard stubSymbols(missing) else {
+            NSLog("Couldn't stub the missing symbols of \(fileURL.lastPathComponent)")
+            return false
+        }
+        NSLog("Stubbed \(missing.count) missing symbols of \(fileURL.lastPathComponent)")
+        return true
     }
     
-    
-    private func performPlatformPatch(filePath: String, targetPlatform: UInt32) -> String? {
-        let fd = open(filePath, O_RDWR)
-        guard fd >= 0 else {
-            NSLog("Failed to open file: \(String(cString: strerror(errno)))")
-            return nil
-        }
-        defer { close(fd) }
-        
-        var fileStat = stat()
-        guard fstat(fd, &fileStat) == 0 else {
-            NSLog("Failed to get file stats: \(String(cString: strerror(errno)))")
-            return nil
+    /// Binds the imports named in `symbols` to a stub dylib generated for them
+    /// and copied next to the patched image. Returns false when the image has
+    /// neither chained fixups nor bind opcodes to retarget.
+    func stubSymbols(_ symbols: [String]) -> Bool {
+        let imported: Set<String>
+        do {
+            let file = try MappedFile(path: patchedURL.path, writable: false)
+            guard let slice = try file.preferredARM64Slice() else { return false }
+            
+            if let fixups = try ChainedFixups(slice) {
+                imported = Set(fixups.imports.map(\.name))
+            } else if let binds = try DyldInfoBinds(slice) {
+                imported = binds.importedSymbols
+            } else {
+                return false
+            }
+        } catch {
+            NSLog("Error reading imports of \(patchedURL.lastPathComponent): \(error)")
+            return false
         }
         
-        let mapFlags: Int32
-        #if os(iOS)
-        mapFlags = MAP_SHARED
-        #else
-        mapFlags = MAP_PRIVATE
-        #endif
+        let stubbed = Set(symbols).filter { imported.contains($0) && StubDylibBuilder.canStub($0) }.sorted()
+        guard !stubbed.isEmpty else { return true }
         
-        guard let fileData = mmap(nil, Int(fileStat.st_size), PROT_READ | PROT_WRITE, mapFlags, fd, 0) else {
-            NSLog("Failed to mmap file: \(String(cString: strerror(errno)))")
-            return nil
+        do {
+            let library = try StubDylibBuilder().install(stubbed, beside: patchedURL)
+            return redirectImports(stubbed, to: library)
+        } catch {
+            NSLog("Error building stub dylib for \(patchedURL.lastPathComponent): \(error)")
+            return false
+        }
+    }
+    
+    /// Recipes only cover the image itself, so after a replay the stub dylibs
+    /// it loads are rebuilt from the imports bound to them.
+    private func restoreStubs() -> Bool {
+        do {
+            let file = try MappedFile(path: patchedURL.path, writable: false)
+            guard let slice = try file.preferredARM64Slice() else { return true }
+            
+            let imports: [(name: String, libraryOrdinal: Int)]
+            if let fixups = try ChainedFixups(slice) {
+                imports = fixups.imports.map { ($0.name, $0.libraryOrdinal) }
+            } else if let binds = try DyldInfoBinds(slice) {
+                imports = (binds.binds + binds.lazyBinds.map(\.bind)).map { ($0.name, $0.libraryOrdinal) }
+            } else {
+                return true
+            }
+            
+            let prefix = "@loader_path/" + StubDylibBuilder.namePrefix
+            for (index, library) in slice.dylibLoadNames.enumerated() where library.hasPrefix(prefix) {
+                let symbols = imports.filter { $0.libraryOrdinal == index + 1 }.map(\.name)
+                try StubDylibBuilder().install(symbols, beside: patchedURL, as: String(library.dropFirst("@loader_path/".count)))
+            }
+            return true
+        } catch {
+            NSLog("Error restoring stub dylibs for \(patchedURL.lastPathComponent): \(error)")
+            return false
         }
-        defer { munmap(fileData, Int(fileStat.st_size)) }
+    }
+    
+    /// Replaces the stale signature of the patched copy with an ad-hoc one.
+    /// Has to run last: any byte changed afterwards invalidates a page hash.
+    func signPatchedImage() -> Bool {
+        let identifier = patchedURL.deletingPathExtension().lastPathComponent
         
-        let success = patchMachOFile(fileData: fileData, targetPlatform: targetPlatform)
-        guard success else {
-            return nil
+        do {
+            try CodeSigner(identifier: identifier).sign(patchedURL.path)
+            return true
+        } catch {
+            NSLog("Error signing \(patchedURL.lastPathComponent): \(error)")
+            return false
         }
+    }
+    
+    func patchKnownFrameworks(_ frameworks: [(String, String)] = []) {
+        let rules = remapRules.adding(frameworks)
+        let remapper = DylibRemapper(rules)
+        let stringRemapper = FrameworkStringRemapper(rules)
+        
+        withPatchedFile { file in
+            for slice in try file.slices() where slice.cputype == CPU_TYPE_ARM64 {
+                remapper.remap(slice)
+                stringRemapper.rewrite(slice)
+            }
+        }
+    }
+    
+    /// Rebuilds the patched image from a recipe recorded by an earlier patch of
+    /// the same input. Returns false so the caller can patch from scratch.
+    private func replay(_ recipe: PatchRecipe) -> Bool {
+        guard copyOriginalFile() else { return false }
         
-        msync(fileData, Int(fileStat.st_size), MS_SYNC)
+        do {
+            try recipe.apply(to: patchedURL.path)
+        } catch {
+            NSLog("Patch recipe for \(fileURL.lastPathComponent) didn't apply: \(error)")
+            return false
+        }
         
+        return restoreStubs() && setExecutablePermissions()
+    }
+    
+    /// Diffs the finished image against the copy it started from and stores the
+    /// result, so the next miss for this input is a replay.
+    private func recordRecipe(for key: String) {
         do {
-            try FileManager.default.setAttributes([.posixPermissions: 0o755], ofItemAtPath: filePath)
-            return filePath
+            let original = try MappedFile(path: fileURL.path, writable: false)
+            let patched = try MappedFile(path: patchedURL.path, writable: false)
+            let base = try baseRange(of: original)
+            
+            let recipe = PatchRecipe.record(
+                base: UnsafeRawBufferPointer(start: original.base.advanced(by: base.offset), count: base.size),
+                patched: UnsafeRawBufferPointer(start: patched.base, count: patched.size),
+                inputDigest: try PatchCache.shared.contentDigest(of: fileURL)
+            )
+            PatchCache.shared.storeRecipe(recipe, for: key)
         } catch {
-            NSLog("Failed to set permissions: \(error)")
-            return nil
+            NSLog("Failed to record patch recipe: \(error)")
         }
     }
     
-    private func patchMachOFile(fileData: UnsafeRawPointer, targetPlatform: UInt32) -> Bool {
-        let magic = fileData.load(as: UInt32.self)
-        var foundAny = false
+    /// The bytes of the original that `copyOriginalFile` starts from: the
+    /// preferred arm64 slice when thinning a universal binary, else the whole file.
+    private func baseRange(of original: MappedFile) throws -> (offset: Int, size: Int) {
+        guard thinUniversalBinaries, original.isUniversal else {
+            return (0, original.size)
+        }
         
-        switch magic {
-        case FAT_MAGIC, FAT_CIGAM:
-            foundAny = patchFatBinary(fileData: fileData, targetPlatform: targetPlatform)
-            
-        case MH_MAGIC_64:
-            foundAny = patchSlice(fileData, targetPlatform: targetPlatform) ?? false
-            
-        default:
-            NSLog("Unsupported Mach-O magic: \(String(format: "%08x", magic))")
+        guard let slice = try original.preferredARM64Slice() else {
+            throw MachOError("No arm64 slice in \(original.path)")
+        }
+        return (slice.offset, slice.size)
+    }
+    
+    func copyOriginalFile() -> Bool {
+        do {
+            if FileManager.default.fileExists(atPath: patchedURL.path) {
+                try FileManager.default.removeItem(at: patchedURL)
+            }
+            if thinUniversalBinaries, try thinCopy(from: fileURL.path, to: patchedURL.path) {
+                return true
+            }
+            try cloneOrCopy(from: fileURL.path, to: patchedURL.path)
+            return true
+        } catch {
+            NSLog("Error copying file: \(error)")
             return false
         }
+    }
+    
+    private func ensurePatchedCopy() -> Bool {
+        guard !FileManager.default.fileExists(atPath: patchedURL.path) else { return true }
+        return copyOriginalFile()
+    }
+    
+    /// Clones `source` when the volume supports it (APFS), so the patched copy
+    /// shares every block with the original until a patch dirties a page. Other
+    /// volumes fall back to a streamed copy.
+    private func cloneOrCopy(from source: String, to destination: String) throws {
+        if clonefile(source, destination, 0) == 0 {
+            return
+        }
         
-        if !foundAny {
-            NSLog("No LC_BUILD_VERSION found in any slice")
+        if errno != ENOTSUP && errno != EXDEV {
+            NSLog("clonefile failed, copying instead: \(String(cString: strerror(errno)))")
         }
+        unlink(destination)
         
-        return foundAny
+        try streamCopy(from: source, to: destination)
     }
     
-    private func patchFatBinary(fileData: UnsafeRawPointer, targetPlatform: UInt32) -> Bool {
-        let fatHeader = fileData.load(as: fat_header.self)
-        let archCount = Int(UInt32(bigEndian: fatHeader.nfat_arch))
-        var foundAny = false
+    /// Writes just the loadable arm64 slice of a universal binary to `destination`,
+    /// roughly halving what gets stored and mapped. Returns false for thin inputs
+    /// so the caller can clone them instead.
+    private func thinCopy(from source: String, to destination: String) throws -> Bool {
+        let original = try MappedFile(path: source, writable: false)
+        guard original.isUniversal else { return false }
         
-        for i in 0..<archCount {
-            let archOffset = MemoryLayout<fat_header>.size + i * MemoryLayout<fat_arch>.size
-            let archPtr = fileData.advanced(by: archOffset)
-            let arch = archPtr.load(as: fat_arch.self)
-            let sliceOffset = Int(UInt32(bigEndian: arch.offset))
-            
-            guard let patched = patchSlice(fileData.advanced(by: sliceOffset), targetPlatform: targetPlatform) else {
-                NSLog("Failed to patch slice at offset \(sliceOffset)")
-                continue
-            }
-            
-            foundAny = foundAny || patched
+        let slice = try baseRange(of: original)
+        
+        let output = open(destination, O_WRONLY | O_CREAT | O_TRUNC, 0o755)
+        guard output >= 0 else {
+            throw MachOError.posix("Failed to create", destination)
         }
+        defer { close(output) }
         
-        return foundAny
+        try writeAll(output, UnsafeRawPointer(original.base.advanced(by: slice.offset)), count: slice.size, path: destination)
+        
+        NSLog("Thinned \(fileURL.lastPathComponent) to its arm64 slice (\(slice.size) of \(original.size) bytes)")
+        return true
     }
     
-    private func patchSlice(_ slicePtr: UnsafeRawPointer, targetPlatform: UInt32) -> Bool? {
-        let header = slicePtr.assumingMemoryBound(to: mach_header_64.self)
-        guard header.pointee.magic == MH_MAGIC_64 else {
-            return nil
+    /// Copies `source` to `destination` in fixed-size chunks so the binary is never
+    /// held in memory as a whole.
+    private func streamCopy(from source: String, to destination: String) throws {
+        let input = open(source, O_RDONLY)
+        guard input >= 0 else {
+            throw MachOError.posix("Failed to open", source)
         }
+        defer { close(input) }
         
-        var cmdPtr = slicePtr.advanced(by: MemoryLayout<mach_header_64>.size)
-        var platformFound = false
+        let output = open(destination, O_WRONLY | O_CREAT | O_TRUNC, 0o755)
+        guard output >= 0 else {
+            throw MachOError.posix("Failed to create", destination)
+        }
+        defer { close(output) }
         
-        for _ in 0..<header.pointee.ncmds {
-            let cmd = cmdPtr.assumingMemoryBound(to: load_command.self)
-            
-            if cmd.pointee.cmd == LC_BUILD_VERSION {
-                let buildCmd = UnsafeMutablePointer<build_version_command>(OpaquePointer(cmd))
-                NSLog("Patching platform from \(buildCmd.pointee.platform) to \(targetPlatform)")
-                buildCmd.pointee.platform = targetPlatform
-                platformFound = true
+        let chunkSize = 1 << 20
+        let buffer = UnsafeMutableRawPointer.allocate(byteCount: chunkSize, alignment: 16384)
+        defer { buffer.deallocate() }
+        
+        while true {
+            let readCount = read(input, buffer, chunkSize)
+            if readCount == 0 { break }
+            if readCount < 0 {
+                if errno == EINTR { continue }
+                throw MachOError.posix("Failed to read", source)
             }
             
-            cmdPtr = cmdPtr.advanced(by: Int(cmd.pointee.cmdsize))
+            try writeAll(output, UnsafeRawPointer(buffer), count: readCount, path: destination)
         }
-        
-        return platformFound
     }
     
-    
-    typealias ParseMachOCallback = (
-        _ path: UnsafePointer<CChar>,
-        _ header: UnsafeMutablePointer<mach_header_64>,
-        _ fd: Int32,
-        _ filePtr: UnsafeMutableRawPointer
-    ) -> Void
-    
-    private func parseMachOFile(path: String, callback: ParseMachOCallback) -> String? {
-        return path.withCString { cPath in
-            parseMachO(path: cPath, callback: callback)
+    private func writeAll(_ fd: Int32, _ bytes: UnsafeRawPointer, count: Int, path: String) throws {
+        var written = 0
+        while written < count {
+            let writeCount = write(fd, bytes.advanced(by: written), count - written)
+            if writeCount < 0 {
+                if errno == EINTR { continue }
+                throw MachOError.posix("Failed to write", path)
+            }
+            written += writeCount
         }
     }
     
-    private func parseMachO(path: UnsafePointer<CChar>, callback: ParseMachOCallback) -> String? {
-        let fd = open(path, O_RDWR, 0o600)
-        guard fd >= 0 else {
-            return String(format: "Failed to open %s: %s", path, strerror(errno))
+    /// Maps the patched file once, hands it to `body` and syncs it back.
+    @discardableResult
+    private func withPatchedFile(_ body: (MappedFile) throws -> Void) -> Bool {
+        do {
+            let file = try MappedFile(path: patchedURL.path)
+            try body(file)
+            file.sync()
+            return true
+        } catch {
+            NSLog("Error patching \(patchedURL.lastPathComponent): \(error)")
+            return false
         }
-        defer { close(fd) }
-        
-        var fileStat = stat()
-        guard fstat(fd, &fileStat) == 0 else {
-            return String(format: "Failed to stat %s: %s", path, strerror(errno))
+    }
+    
+    private func setExecutablePermissions() -> Bool {
+        do {
+            try FileManager.default.setAttributes([.posixPermissions: 0o755], ofItemAtPath: patchedURL.path)
+            return true
+        } catch {
+            NSLog("Failed to set permissions: \(error)")
+            return false
         }
+    }
+    
+    
+    func patchPlatform(targetPlatform: Int32) -> String? {
+        guard ensurePatchedCopy() else { return nil }
         
-        guard let map = mmap(nil, Int(fileStat.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0),
-              map != MAP_FAILED else {
-            return String(format: "Failed to map %s: %s", path, strerror(errno))
-        }
-        defer {
-            msync(map, Int(fileStat.st_size), MS_SYNC)
-            munmap(map, Int(fileStat.st_size))
+        var platformFound = false
+        let patched = withPatchedFile { file in
+            for slice in try file.slices() {
+                if patchPlatform(in: slice, targetPlatform: UInt32(targetPlatform)) {
+                    platformFound = true
+                }
+            }
         }
         
-        let magic = map.load(as: UInt32.self)
+        guard patched else { return nil }
         
-        switch magic {
-        case FAT_CIGAM:
-            return parseFatBinaryForCallback(map: map, path: path, callback: callback)
-            
-        case MH_MAGIC_64, MH_MAGIC:
-            let machHeader = map.bindMemory(to: mach_header_64.self, capacity: 1)
-            callback(path, machHeader, fd, map)
+        if !platformFound {
+            NSLog("No LC_BUILD_VERSION found in any slice")
             return nil
-            
-        default:
-            return "Not a Mach-O file"
         }
+        
+        guard setExecutablePermissions() else { return nil }
+        
+        return patchedURL.path
     }
     
-    private func parseFatBinaryForCallback(map: UnsafeMutableRawPointer, path: UnsafePointer<CChar>, callback: ParseMachOCallback) -> String? {
-        let fatHeader = map.bindMemory(to: fat_header.self, capacity: 1)
-        var arch = (map + MemoryLayout<fat_header>.size).bindMemory(to: fat_arch.self, capacity: 1)
-        
-        let archCount = Self.OSSwapInt32(fatHeader.pointee.nfat_arch)
+    
+    func convertToDylib(doInject: Bool = true) -> String? {
+        guard ensurePatchedCopy() else { return nil }
         
-        for _ in 0..<archCount {
-            if Self.OSSwapInt32(arch.pointee.cputype) == CPU_TYPE_ARM64 {
-                let offset = Int(Self.OSSwapInt32(arch.pointee.offset))
-                let machHeader = (map + offset).bindMemory(to: mach_header_64.self, capacity: 1)
-                callback(path, machHeader, -1, map)
+        let converted = withPatchedFile { file in
+            for slice in try file.slices() where slice.cputype == CPU_TYPE_ARM64 {
+                patchExecSlice(slice, doInject: doInject)
             }
-            arch = arch.advanced(by: 1)
         }
         
-        return nil
+        return converted ? patchedURL.path : nil
     }
     
+    
     @discardableResult
-    private func replacePatternInPatchedFile(pattern: String, replacement: String) -> Bool {
+    func replacePattern(_ pattern: String, with replacement: String) -> Bool {
         guard FileManager.default.fileExists(atPath: patchedURL.path) else {
             print("File does not exist at path: \(patchedURL.path)")
             return false
         }
         
-        do {
-            // Read from patchedURL, not fileURL
-            let fileData = try Data(contentsOf: patchedURL)
-            
-            guard let patternData = pattern.data(using: .utf8),
-                  let replacementData = replacement.data(using: .utf8) else {
-                print("Failed to convert strings to data.")
-                return false
+        return withPatchedFile { file in
+            for slice in try file.slices() where slice.cputype == CPU_TYPE_ARM64 {
+                replaceAll(pattern, with: replacement, in: UnsafeMutableRawBufferPointer(start: slice.base, count: slice.size))
             }
-            
-            let modifiedData = replacePattern(in: fileData, pattern: patternData, replacement: replacementData)
-            
-            // Write back to patchedURL
-            try modifiedData.write(to: patchedURL)
-            // print("File successfully modified: \(pattern) -> \(replacement)")
-            return true
-        } catch {
-            print("Error reading or writing the file: \(error)")
-            return false
         }
     }
     
-    private func replacePattern(in data: Data, pattern: Data, replacement: Data) -> Data {
-        var modifiedData = data
-        var currentIndex = 0
+    
+    static func OSSwapInt32(_ value: UInt32) -> UInt32 {
+        return value.byteSwapped
+    }
+    
+    static func OSSwapInt32(_ value: Int32) -> Int32 {
+        return value.byteSwapped
+    }
+    
+    
+    private func patchPlatform(in slice: MachOSlice, targetPlatform: UInt32) -> Bool {
+        var platformFound = false
         
-        while let range = modifiedData.range(of: pattern, options: [], in: currentIndex..<modifiedData.count) {
-            let patternLength = range.upperBound - range.lowerBound
-            let replacementLength = replacement.count
-            
-            if replacementLength < patternLength {
-                let paddedReplacement = replacement + Data(repeating: 0, count: patternLength - replacementLength)
-                modifiedData.replaceSubrange(range, with: paddedReplacement)
-            } else {
-                modifiedData.replaceSubrange(range, with: replacement)
+        slice.forEachLoadCommand { command, _ in
+            if command.pointee.cmd == LC_BUILD_VERSION {
+                let buildCmd = UnsafeMutableRawPointer(command).assumingMemoryBound(to: build_version_command.self)
+                NSLog("Patching platform from \(buildCmd.pointee.platform) to \(targetPlatform)")
+                buildCmd.pointee.platform = targetPlatform
+                platformFound = true
             }
+            return true
+        }
+        
+        return platformFound
+    }
+    
+    /// Replaces every occurrence of `pattern` inside the mapped buffer. Shorter
+    /// replacements are NUL padded; longer ones are refused since they would
+    /// shift every following byte and corrupt file offsets.
+    @discardableResult
+    private func replaceAll(_ pattern: String, with replacement: String, in buffer: UnsafeMutableRawBufferPointer) -> Int {
+        let patternBytes = Array(pattern.utf8)
+        let replacementBytes = Array(replacement.utf8)
+        
+        guard !patternBytes.isEmpty, let start = buffer.baseAddress else { return 0 }
+        
+        guard replacementBytes.count <= patternBytes.count else {
+            NSLog("Skipping \(pattern): replacement is longer than the original")
+            return 0
+        }
+        
+        let end = start.advanced(by: buffer.count)
+        var cursor = start
+        var replaced = 0
+        
+        while cursor < end, let hit = memmem(cursor, cursor.distance(to: end), patternBytes, patternBytes.count) {
+            replacementBytes.withUnsafeBytes { hit.copyMemory(from: $0.baseAddress!, byteCount: $0.count) }
+            memset(hit.advanced(by: replacementBytes.count), 0, patternBytes.count - replacementBytes.count)
             
-            currentIndex = range.upperBound
+            cursor = hit.advanced(by: patternBytes.count)
+            replaced += 1
         }
         
-        return modifiedData
+        return replaced
     }
     
     
-    private func patchExecSlice(path: UnsafePointer<CChar>, header: UnsafeMutablePointer<mach_header_64>, doInject: Bool) {
-        let imageHeaderPtr = UnsafeMutableRawPointer(header).advanced(by: MemoryLayout<mach_header_64>.size)
+    private func patchExecSlice(_ slice: MachOSlice, doInject: Bool) {
+        let header = slice.header
+        let imageHeaderPtr = slice.base.advanced(by: MemoryLayout<mach_header_64>.size)
         
         // Convert executable to dylib
         convertExecutableToDylib(header: header)
@@ -402,7 +607,7 @@ class MachOPatcher: Equatable {
         patchPageZeroSegment(imageHeaderPtr: imageHeaderPtr)
         
         // Handle dylib commands
-        handleDylibCommands(path: path, header: header, doInject: doInject)
+        handleDylibCommands(in: slice, doInject: doInject)
     }
     
     private func convertExecutableToDylib(header: UnsafeMutablePointer<mach_header_64>) {
@@ -428,340 +633,204 @@ class MachOPatcher: Equatable {
         }
     }
     
-    private func handleDylibCommands(path: UnsafePointer<CChar>, header: UnsafeMutablePointer<mach_header_64>, doInject: Bool) {
-        let imageHeaderPtr = UnsafeMutableRawPointer(header).advanced(by: MemoryLayout<mach_header_64>.size)
+    private func handleDylibCommands(in slice: MachOSlice, doInject: Bool) {
         var hasDylibCommand = false
         var dylibLoaderCommand: UnsafeMutablePointer<dylib_command>?
         let libCppPath = "/usr/lib/libc++.1.dylib"
         
-        var command = imageHeaderPtr.bindMemory(to: load_command.self, capacity: 1)
-        
-        for _ in 0..<header.pointee.ncmds {
+        slice.forEachLoadCommand { command, _ in
             switch command.pointee.cmd {
             case UInt32(LC_ID_DYLIB):
                 hasDylibCommand = true
-                
-            case 0x114514:
-                dylibLoaderCommand = UnsafeMutablePointer<dylib_command>(OpaquePointer(command))
-                
+            
+            case MachOLoadCommand.parkedDylib:
+                dylibLoaderCommand = UnsafeMutableRawPointer(command).assumingMemoryBound(to: dylib_command.self)
+            
             default:
                 break
             }
-            
-            command = UnsafeMutableRawPointer(command)
-                .advanced(by: Int(command.pointee.cmdsize))
-                .bindMemory(to: load_command.self, capacity: 1)
+            return true
         }
         
         if let dylibLoaderCommand = dylibLoaderCommand {
-            dylibLoaderCommand.pointee.cmd = doInject ? UInt32(LC_LOAD_DYLIB) : 0x114514
+            dylibLoaderCommand.pointee.cmd = doInject ? UInt32(LC_LOAD_DYLIB) : MachOLoadCommand.parkedDylib
             
             let namePtr = UnsafeMutableRawPointer(dylibLoaderCommand)
                 .advanced(by: Int(dylibLoaderCommand.pointee.dylib.name.offset))
             strcpy(namePtr.assumingMemoryBound(to: CChar.self), libCppPath)
         } else {
             insertDylibCommand(
-                cmd: doInject ? UInt32(LC_LOAD_DYLIB) : 0x114514,
+                cmd: doInject ? UInt32(LC_LOAD_DYLIB) : MachOLoadCommand.parkedDylib,
                 path: libCppPath,
-                header: header
+                in: slice
             )
         }
         
         if !hasDylibCommand {
-            insertDylibCommand(cmd: UInt32(LC_ID_DYLIB), path: path, header: header)
+            insertDylibCommand(cmd: UInt32(LC_ID_DYLIB), path: patchedURL.lastPathComponent, in: slice)
         }
     }
     
-    private func insertDylibCommand(cmd: UInt32, path: UnsafePointer<CChar>, header: UnsafeMutablePointer<mach_header_64>) {
-        let name = determineName(cmd: cmd, path: path)
-        let nameLength = strlen(name) + 1
-        let cmdSize = MemoryLayout<dylib_command>.size + Int(rnd32(UInt32(nameLength), 8))
-        
-        let headerPtr = UnsafeMutableRawPointer(header)
-        let dylibPtr = getDylibCommandPointer(cmd: cmd, header: header, cmdSize: cmdSize, headerPtr: headerPtr)
-        
-        configureDylibCommand(dylibPtr: dylibPtr, cmd: cmd, cmdSize: cmdSize, name: name, nameLength: nameLength)
+    /// LC_ID_DYLIB goes in front of every other command, anything else at the end.
+    /// The header space manager makes sure the command never spills into `__text`.
+    @discardableResult
+    private func insertDylibCommand(cmd: UInt32, path: String, in slice: MachOSlice) -> Bool {
+        let command = MachOSlice.dylibCommand(cmd, path: path)
+        let space = HeaderSpace(slice)
         
-        header.pointee.ncmds += 1
-        header.pointee.sizeofcmds += UInt32(cmdSize)
+        do {
+            try space.reserve(command.count)
+            try space.insert(command, at: cmd == UInt32(LC_ID_DYLIB) ? slice.loadCommandsOffset : nil)
+            return true
+        } catch {
+            NSLog("Failed to insert load command for \(path): \(error)")
+            return false
+        }
     }
     
-    private func determineName(cmd: UInt32, path: UnsafePointer<CChar>) -> UnsafePointer<CChar> {
-        if cmd == LC_ID_DYLIB {
-            guard let base = basename(UnsafeMutablePointer(mutating: path)) else {
-                return path
-            }
-            return UnsafePointer(base)
-        } else {
-            return path
+    static let defaultSymbolsToRemove = [
+        "CGDisplayCopyAllDisplayModes",
+        "_CGDisplayCopyAllDisplayModes",
+        "_CGDisplayModeCopyPixelEncoding",
+        "_CGDisplayModeGetPixelWidth",
+        "_CGDisplayModeGetPixelHeight",
+        "_CGDisplayModeGetRefreshRate",
+        "_CGDisplayModeRelease",
+        "_CGMainDisplayID",
+        "_CGDisplayBounds",
+        "_CGDisplayPixelsWide",
+        "_CGDisplayPixelsHigh"
+    ]
+    
+    /// Stubs the given undefined symbols, or zeroes their symbol table entries
+    /// when stubs are off or the image has no imports table or bind opcodes.
+    func patchUndefinedSymbols(_ symbolsToRemove: [String] = []) -> Bool {
+        let symbols = Self.defaultSymbolsToRemove + symbolsToRemove
+        if synthesizeStubs, stubSymbols(symbols) {
+            return true
         }
+        return patchSymbols(remove: symbols)
     }
     
-    func patchUndefinedSymbols(_ symbolsToRemove: [String] = []) -> Bool {
+    /// Patches out weak symbols that might cause loading issues
+    func patchWeakSymbols(_ symbolsToWeaken: [String] = []) -> Bool {
+        patchSymbols(weaken: symbolsToWeaken)
+    }
+    
+    /// Removes undefined symbols and weakens symbols in a single walk of the
+    /// symbol table. Names are matched straight out of the string table.
+    func patchSymbols(remove symbolsToRemove: [String] = [], weaken symbolsToWeaken: [String] = []) -> Bool {
         guard FileManager.default.fileExists(atPath: patchedURL.path) else {
             NSLog("Patched file does not exist")
             return false
         }
         
-        let defaultSymbolsToRemove = [
-            "CGDisplayCopyAllDisplayModes",
-            "_CGDisplayCopyAllDisplayModes",
-            "_CGDisplayModeCopyPixelEncoding",
-            "_CGDisplayModeGetPixelWidth",
-            "_CGDisplayModeGetPixelHeight",
-            "_CGDisplayModeGetRefreshRate",
-            "_CGDisplayModeRelease",
-            "_CGMainDisplayID",
-            "_CGDisplayBounds",
-            "_CGDisplayPixelsWide",
-            "_CGDisplayPixelsHigh"
-        ]
-        
-        let allSymbolsToRemove = defaultSymbolsToRemove + symbolsToRemove
-        
-        let error = parseMachOFile(path: patchedURL.path) { [weak self] path, header, fd, filePtr in
-            if header.pointee.cputype == CPU_TYPE_ARM64 {
-                self?.patchSymbolsInSlice(path: path, header: header, filePtr: filePtr, symbolsToRemove: allSymbolsToRemove)
+        let removals = SymbolNameSet(symbolsToRemove)
+        let weakenings = SymbolNameSet(symbolsToWeaken)
+        
+        return withPatchedFile { file in
+            for slice in try file.slices() where slice.cputype == CPU_TYPE_ARM64 {
+                patchSymbolTable(in: slice, removing: removals, weakening: weakenings)
             }
         }
-        
-        if let error = error {
-            NSLog("Error patching symbols: \(error)")
+    }
+    
+    /// Points the imports named in `symbols` at `library`, adding a load command
+    /// for it if needed. Only the chained-fixup imports table or the bind
+    /// opcodes change, plus the offsets in `__stub_helper` when the lazy bind
+    /// stream has to be rebuilt. Bind opcodes are checked before anything is
+    /// written, so a redirect that can't be done leaves the image untouched.
+    func redirectImports(_ symbols: [String], to library: String) -> Bool {
+        guard FileManager.default.fileExists(atPath: patchedURL.path) else {
+            NSLog("Patched file does not exist")
             return false
         }
         
-        return true
-    }
-
-    private func patchSymbolsInSlice(path: UnsafePointer<CChar>, header: UnsafeMutablePointer<mach_header_64>, filePtr: UnsafeMutableRawPointer, symbolsToRemove: [String]) {
-        var dysymtabCmd: UnsafeMutablePointer<dysymtab_command>?
-        var symtabCmd: UnsafeMutablePointer<symtab_command>?
-        var linkeditSegment: UnsafeMutablePointer<segment_command_64>?
-        
-        // Find relevant load commands
-        var command = UnsafeMutableRawPointer(header).advanced(by: MemoryLayout<mach_header_64>.size).bindMemory(to: load_command.self, capacity: 1)
-        
-        for _ in 0..<header.pointee.ncmds {
-            switch command.pointee.cmd {
-            case UInt32(LC_DYSYMTAB):
-                dysymtabCmd = UnsafeMutablePointer<dysymtab_command>(OpaquePointer(command))
-                
-            case UInt32(LC_SYMTAB):
-                symtabCmd = UnsafeMutablePointer<symtab_command>(OpaquePointer(command))
-                
-            case UInt32(LC_SEGMENT_64):
-                let segment = UnsafeMutablePointer<segment_command_64>(OpaquePointer(command))
-                let segName = withUnsafePointer(to: segment.pointee.segname) {
-                    String(cString: UnsafeRawPointer($0).assumingMemoryBound(to: CChar.self))
-                }
-                if segName == "__LINKEDIT" {
-                    linkeditSegment = segment
+        let wanted = Set(symbols)
+        
+        return withPatchedFile { file in
+            for slice in try file.slices() where slice.cputype == CPU_TYPE_ARM64 {
+                if var fixups = try ChainedFixups(slice) {
+                    let matches = fixups.imports.indices.filter { wanted.contains(fixups.imports[$0].name) }
+                    guard !matches.isEmpty else { continue }
+                    
+                    let ordinal = try fixups.addLibrary(library)
+                    for index in matches {
+                        fixups.retarget(index, toLibrary: ordinal)
+                    }
+                    try fixups.write()
+                    
+                    NSLog("Redirected \(matches.count) imports to \(library)")
+                } else if var binds = try DyldInfoBinds(slice) {
+                    let matches = binds.importedSymbols.intersection(wanted)
+                    guard !matches.isEmpty else { continue }
+                    
+                    try binds.checkRedirect(of: matches, toLibrary: library)
+                    let ordinal = try binds.addLibrary(library)
+                    var count = 0
+                    for symbol in matches {
+                        count += binds.retarget(symbol: symbol, toLibrary: ordinal)
+                    }
+                    try binds.write()
+                    
+                    NSLog("Redirected \(count) binds to \(library)")
+                } else {
+                    NSLog("No chained fixups or bind opcodes in slice, nothing to redirect")
                 }
-                
-            default:
-                break
             }
-            
-            command = UnsafeMutableRawPointer(command).advanced(by: Int(command.pointee.cmdsize)).bindMemory(to: load_command.self, capacity: 1)
         }
-        
-        guard let dysymtab = dysymtabCmd,
-              let symtab = symtabCmd,
-              let linkedit = linkeditSegment else {
-            NSLog("Could not find required symbol table commands")
+    }
+    
+    private func patchSymbolTable(in slice: MachOSlice, removing removals: SymbolNameSet, weakening weakenings: SymbolNameSet) {
+        guard let symtab = slice.firstCommand(MachOLoadCommand.symtab, as: symtab_command.self) else {
+            NSLog("Could not find symbol table")
             return
         }
         
-        // Calculate base addresses
-        let linkeditBase = filePtr.advanced(by: Int(linkedit.pointee.fileoff))
-        let stringTable = linkeditBase.advanced(
-            by: Int(UInt64(symtab.pointee.stroff) - linkedit.pointee.fileoff)
-        )
-        let symbolTable = linkeditBase.advanced(
-            by: Int(UInt64(symtab.pointee.symoff) - linkedit.pointee.fileoff)
-        ).bindMemory(to: nlist_64.self, capacity: Int(symtab.pointee.nsyms))
-
-        // Process undefined symbols
-        patchUndefinedSymbolsInTable(
-            symbolTable: symbolTable,
-            stringTable: stringTable,
-            dysymtab: dysymtab,
-            symbolsToRemove: symbolsToRemove
+        let dysymtab = slice.firstCommand(MachOLoadCommand.dysymtab, as: dysymtab_command.self)
+        if dysymtab == nil && !removals.isEmpty {
+            NSLog("Could not find LC_DYSYMTAB, undefined symbols are left alone")
+        }
+        
+        // Symbol and string table offsets are relative to the start of the slice
+        let stringTable = UnsafePointer(slice.base.advanced(by: Int(symtab.pointee.stroff)).assumingMemoryBound(to: UInt8.self))
+        let stringTableSize = Int(symtab.pointee.strsize)
+        let symbols = UnsafeMutableBufferPointer(
+            start: slice.base.advanced(by: Int(symtab.pointee.symoff)).bindMemory(to: nlist_64.self, capacity: Int(symtab.pointee.nsyms)),
+            count: Int(symtab.pointee.nsyms)
         )
-    }
-
-    private func patchUndefinedSymbolsInTable(
-        symbolTable: UnsafeMutablePointer<nlist_64>,
-        stringTable: UnsafeMutableRawPointer,
-        dysymtab: UnsafeMutablePointer<dysymtab_command>,
-        symbolsToRemove: [String]
-    ) {
-        let undefinedStart = Int(dysymtab.pointee.iundefsym)
-        let undefinedCount = Int(dysymtab.pointee.nundefsym)
         
+        let undefined = dysymtab.map { Int($0.pointee.iundefsym)..<Int($0.pointee.iundefsym + $0.pointee.nundefsym) } ?? 0..<0
         var removedCount: UInt32 = 0
+        var weakenedCount = 0
         
-        for i in 0..<undefinedCount {
-            let symbolIndex = undefinedStart + i
-            let symbol = symbolTable.advanced(by: symbolIndex)
+        for i in symbols.indices {
+            let nameOffset = Int(symbols[i].n_un.n_strx)
+            guard nameOffset > 0, nameOffset < stringTableSize else { continue }
             
-            // Get symbol name
-            let nameOffset = Int(symbol.pointee.n_un.n_strx)
-            let symbolName = String(cString: stringTable.advanced(by: nameOffset).assumingMemoryBound(to: CChar.self))
+            let name = stringTable.advanced(by: nameOffset)
             
-            // Check if this symbol should be removed
-            if symbolsToRemove.contains(symbolName) {
-                NSLog("Removing undefined symbol: \(symbolName)")
-                
-                // Mark symbol as removed by setting n_type to 0
-                symbol.pointee.n_type = 0
-                symbol.pointee.n_sect = 0
-                symbol.pointee.n_desc = 0
-                symbol.pointee.n_value = 0
-                symbol.pointee.n_un.n_strx = 0
+            if undefined.contains(i), let match = removals.index(ofCString: name) {
+                NSLog("Removing undefined symbol: \(String(decoding: removals.names[match], as: UTF8.self))")
                 
+                // Mark symbol as removed by clearing the entry
+                symbols[i] = nlist_64()
                 removedCount += 1
+            } else if let match = weakenings.index(ofCString: name) {
+                symbols[i].n_desc |= UInt16(N_WEAK_DEF)
+                weakenedCount += 1
+                NSLog("Weakened symbol: \(String(decoding: weakenings.names[match], as: UTF8.self))")
             }
         }
         
         // Update the dysymtab command to reflect removed symbols
-        if removedCount > 0 {
+        if removedCount > 0, let dysymtab {
             dysymtab.pointee.nundefsym -= removedCount
             NSLog("Removed \(removedCount) undefined symbols")
         }
-    }
-
-    /// Patches out weak symbols that might cause loading issues
-    func patchWeakSymbols(_ symbolsToWeaken: [String] = []) -> Bool {
-        guard FileManager.default.fileExists(atPath: patchedURL.path) else {
-            NSLog("Patched file does not exist")
-            return false
-        }
         
-        let error = parseMachOFile(path: patchedURL.path) { [weak self] path, header, fd, filePtr in
-            if header.pointee.cputype == CPU_TYPE_ARM64 {
-                self?.weakenSymbolsInSlice(header: header, filePtr: filePtr, symbolsToWeaken: symbolsToWeaken)
-            }
-        }
-        
-        if let error = error {
-            NSLog("Error weakening symbols: \(error)")
-            return false
+        if weakenedCount > 0 {
+            NSLog("Weakened \(weakenedCount) symbols")
         }
-        
-        return true
-    }
-
-    private func weakenSymbolsInSlice(header: UnsafeMutablePointer<mach_header_64>, filePtr: UnsafeMutableRawPointer, symbolsToWeaken: [String]) {
-        var symtabCmd: UnsafeMutablePointer<symtab_command>?
-        var linkeditSegment: UnsafeMutablePointer<segment_command_64>?
-        
-        // Find symbol table and linkedit segment
-        var command = UnsafeMutableRawPointer(header).advanced(by: MemoryLayout<mach_header_64>.size).bindMemory(to: load_command.self, capacity: 1)
-        
-        for _ in 0..<header.pointee.ncmds {
-            switch command.pointee.cmd {
-            case UInt32(LC_SYMTAB):
-                symtabCmd = UnsafeMutablePointer<symtab_command>(OpaquePointer(command))
-                
-            case UInt32(LC_SEGMENT_64):
-                let segment = UnsafeMutablePointer<segment_command_64>(OpaquePointer(command))
-                let segName = withUnsafePointer(to: segment.pointee.segname) {
-                    String(cString: UnsafeRawPointer($0).assumingMemoryBound(to: CChar.self))
-                }
-                if segName == "__LINKEDIT" {
-                    linkeditSegment = segment
-                }
-                
-            default:
-                break
-            }
-            
-            command = UnsafeMutableRawPointer(command).advanced(by: Int(command.pointee.cmdsize)).bindMemory(to: load_command.self, capacity: 1)
-        }
-        
-        guard let symtab = symtabCmd,
-              let linkedit = linkeditSegment else {
-            NSLog("Could not find symbol table")
-            return
-        }
-        
-        let linkeditBase = filePtr.advanced(by: Int(linkedit.pointee.fileoff))
-        let stringTable = linkeditBase.advanced(
-            by: Int(UInt64(symtab.pointee.stroff) - linkedit.pointee.fileoff)
-        )
-
-        let symbolTable = linkeditBase.advanced(
-            by: Int(UInt64(symtab.pointee.symoff) - linkedit.pointee.fileoff)
-        ).bindMemory(to: nlist_64.self, capacity: Int(symtab.pointee.nsyms))
-
-        // Process all symbols
-        for i in 0..<Int(symtab.pointee.nsyms) {
-            let symbol = symbolTable.advanced(by: i)
-            let nameOffset = Int(symbol.pointee.n_un.n_strx)
-            
-            guard nameOffset > 0 else { continue }
-            
-            let symbolName = String(cString: stringTable.advanced(by: nameOffset).assumingMemoryBound(to: CChar.self))
-            
-            if symbolsToWeaken.contains(symbolName) {
-                // Mark symbol as weak
-                symbol.pointee.n_desc |= UInt16(N_WEAK_DEF)
-                NSLog("Weakened symbol: \(symbolName)")
-            }
-        }
-    }
-
-    
-    private func getDylibCommandPointer(
-        cmd: UInt32,
-        header: UnsafeMutablePointer<mach_header_64>,
-        cmdSize: Int,
-        headerPtr: UnsafeMutableRawPointer
-    ) -> UnsafeMutablePointer<dylib_command> {
-        
-        if cmd == LC_ID_DYLIB {
-            let dylibPtr = headerPtr
-                .advanced(by: MemoryLayout<mach_header_64>.size)
-                .assumingMemoryBound(to: dylib_command.self)
-            
-            // Move existing load commands forward to make space
-            let loadCmdsSize = Int(header.pointee.sizeofcmds)
-            let src = UnsafeRawPointer(dylibPtr)
-            let dst = headerPtr.advanced(by: MemoryLayout<mach_header_64>.size + cmdSize)
-            memmove(dst, src, loadCmdsSize)
-            memset(dylibPtr, 0, cmdSize)
-            
-            return dylibPtr
-        } else {
-            return headerPtr
-                .advanced(by: MemoryLayout<mach_header_64>.size + Int(header.pointee.sizeofcmds))
-                .assumingMemoryBound(to: dylib_command.self)
-        }
-    }
-    
-    private func configureDylibCommand(
-        dylibPtr: UnsafeMutablePointer<dylib_command>,
-        cmd: UInt32,
-        cmdSize: Int,
-        name: UnsafePointer<CChar>,
-        nameLength: Int
-    ) {
-        dylibPtr.pointee.cmd = cmd
-        dylibPtr.pointee.cmdsize = UInt32(cmdSize)
-        dylibPtr.pointee.dylib.name.offset = UInt32(MemoryLayout<dylib_command>.size)
-        dylibPtr.pointee.dylib.compatibility_version = 0x10000
-        dylibPtr.pointee.dylib.current_version = 0x10000
-        dylibPtr.pointee.dylib.timestamp = 2
-        
-        let nameDst = UnsafeMutableRawPointer(dylibPtr)
-            .advanced(by: Int(dylibPtr.pointee.dylib.name.offset))
-        strncpy(nameDst.assumingMemoryBound(to: CChar.self), name, nameLength)
-    }
-    
-    
-    private func rnd32(_ value: UInt32, _ roundTo: UInt32) -> UInt32 {
-        let mask = roundTo - 1
-        return (value + mask) & ~mask
     }
 }
@@ -0,0 +1,295 @@
+//
+//  ObjCMetadata.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// The Objective-C classes and libraries an image uses, read from its mapped
+/// file without loading it: classes it imports, the classes named by
+/// `__objc_classrefs` (imported or its own), and those it defines in
+/// `__objc_classlist`.
+///
+/// Pointers in those sections are decoded the way dyld would before fixing
+/// them up: chained binds are resolved to their import names and rebases to
+/// file offsets, so no fixup ever has to be applied. Images without chained
+/// fixups store plain addresses, and their binds are only visible as imports.
+struct ObjCMetadata {
+    enum Interface {
+        case graphical
+        case commandLine
+    }
+
+    static let classSymbolPrefix = "_OBJC_CLASS_$_"
+
+    /// Install names of the libraries the image loads.
+    let libraries: [String]
+    /// Classes bound from other images, without the `_OBJC_CLASS_$_` prefix.
+    let importedClasses: Set<String>
+    /// Classes the code refers to by name, imported or defined here.
+    let referencedClasses: Set<String>
+    /// Classes defined in the image, in `__objc_classlist` order.
+    let definedClasses: [String]
+
+    private static let lock = NSLock()
+    private static var cache: [String: (stamp: FileStamp, metadata: ObjCMetadata)] = [:]
+
+    /// The metadata of the arm64 slice of the file at `path`, parsed once per
+    /// version of the file.
+    static func read(_ path: String) -> ObjCMetadata? {
+        guard let stamp = FileStamp(path: path) else { return nil }
+
+        lock.lock()
+        if let cached = cache[path], cached.stamp == stamp {
+            lock.unlock()
+            return cached.metadata
+        }
+        lock.unlock()
+
+        let metadata: ObjCMetadata
+        do {
+            let file = try MappedFile(path: path, writable: false)
+            guard let slice = try file.preferredARM64Slice() else { return nil }
+            metadata = try ObjCMetadata(slice)
+        } catch {
+            NSLog("Couldn't read Objective-C metadata of \((path as NSString).lastPathComponent): \(error)")
+            return nil
+        }
+
+        lock.lock()
+        cache[path] = (stamp, metadata)
+        lock.unlock()
+        return metadata
+    }
+
+    init(_ slice: MachOSlice) throws {
+        libraries = slice.dylibLoadNames
+
+        let fixups = try ChainedFixups(slice)
+        let importNames = fixups?.imports.map(\.name) ?? slice.undefinedSymbols().map(\.name)
+        importedClasses = Set(importNames.compactMap(Self.className(ofSymbol:)))
+
+        let pointers = PointerReader(slice, imports: fixups?.imports.map(\.name) ?? [])
+
+        var referenced = Set<String>()
+        for offset in pointers.entries(of: "__objc_classrefs") {
+            switch pointers.pointer(at: offset) {
+            case .bind(let name):
+                if let name = Self.className(ofSymbol: name) {
+                    referenced.insert(name)
+                }
+            case .rebase(let target):
+                if let name = pointers.className(ofClassAt: target) {
+                    referenced.insert(name)
+                }
+            case .none:
+                break
+            }
+        }
+        referencedClasses = referenced
+
+        definedClasses = pointers.entries(of: "__objc_classlist").compactMap { offset in
+            guard case .rebase(let target) = pointers.pointer(at: offset) else { return nil }
+            return pointers.className(ofClassAt: target)
+        }
+    }
+
+    // MARK: - Queries
+
+    func references(class name: String) -> Bool {
+        importedClasses.contains(name) || referencedClasses.contains(name)
+    }
+
+    /// Whether the image loads `name`, given as a framework or dylib name
+    /// without extension. Matches both macOS install names and remapped ones.
+    func links(_ name: String) -> Bool {
+        libraries.contains { path in
+            let components = path.split(separator: "/")
+            return components.contains { $0 == name + ".framework" }
+                || components.last.map { $0 == name || $0 == name + ".dylib" || $0 == name + "_iOS" } ?? false
+        }
+    }
+
+    var usesAppKit: Bool {
+        links("AppKit") || links("Cocoa") || references(class: "NSApplication")
+    }
+
+    var usesSwiftUI: Bool {
+        links("SwiftUI")
+    }
+
+    var usesOpenGL: Bool {
+        links("OpenGL") || links("CoreOpenGL") || links("GLUT")
+    }
+
+    /// Whether the image puts up windows or only talks to a terminal.
+    var interface: Interface {
+        usesAppKit || usesSwiftUI || usesOpenGL || references(class: "NSWindow") ? .graphical : .commandLine
+    }
+
+    private static func className(ofSymbol symbol: String) -> String? {
+        symbol.hasPrefix(classSymbolPrefix) ? String(symbol.dropFirst(classSymbolPrefix.count)) : nil
+    }
+}
+
+// MARK: - Pointers
+
+private extension ObjCMetadata {
+    enum Pointer {
+        case bind(String)
+        /// File offset of the target, from the start of the slice.
+        case rebase(Int)
+        case none
+    }
+
+    /// `pointer_format` values from <mach-o/fixup-chains.h>.
+    enum PointerFormat: UInt16 {
+        case arm64e = 1
+        case pointer64 = 2
+        case pointer64Offset = 6
+        case arm64eUserland = 12
+        case arm64eUserland24 = 13
+    }
+
+    struct Segment {
+        let vmaddr: UInt64
+        let vmsize: UInt64
+        let fileoff: UInt64
+        let filesize: UInt64
+        /// Nil when the segment has no chained fixups.
+        var format: PointerFormat?
+    }
+
+    struct PointerReader {
+        let slice: MachOSlice
+        let segments: [Segment]
+        let imports: [String]
+        /// Address of __TEXT; offset-style rebases are relative to it.
+        let imageBase: UInt64
+
+        init(_ slice: MachOSlice, imports: [String]) {
+            self.slice = slice
+            self.imports = imports
+
+            var segments: [Segment] = []
+            slice.forEachLoadCommand { command, _ in
+                if command.pointee.cmd == MachOLoadCommand.segment64 {
+                    let segment = UnsafeMutableRawPointer(command).assumingMemoryBound(to: segment_command_64.self).pointee
+                    segments.append(Segment(vmaddr: segment.vmaddr, vmsize: segment.vmsize, fileoff: segment.fileoff, filesize: segment.filesize))
+                }
+                return true
+            }
+
+            for (index, format) in Self.pointerFormats(in: slice) where segments.indices.contains(index) {
+                segments[index].format = format
+            }
+
+            self.segments = segments
+            imageBase = segments.first { $0.fileoff == 0 && $0.filesize > 0 }?.vmaddr ?? 0
+        }
+
+        /// The pointer format of each segment that has chains, from the
+        /// starts-in-image table of LC_DYLD_CHAINED_FIXUPS.
+        private static func pointerFormats(in slice: MachOSlice) -> [(Int, PointerFormat)] {
+            guard let command = slice.firstCommand(MachOLoadCommand.dyldChainedFixups, as: linkedit_data_command.self) else { return [] }
+
+            let blobOffset = Int(command.pointee.dataoff)
+            let blobSize = Int(command.pointee.datasize)
+            guard blobSize >= 8, blobOffset + blobSize <= slice.size else { return [] }
+
+            let blob = UnsafeRawPointer(slice.base.advanced(by: blobOffset))
+            let startsOffset = Int(blob.loadUnaligned(fromByteOffset: 4, as: UInt32.self))
+            guard startsOffset + 4 <= blobSize else { return [] }
+
+            let segmentCount = Int(blob.loadUnaligned(fromByteOffset: startsOffset, as: UInt32.self))
+            guard startsOffset + 4 + segmentCount * 4 <= blobSize else { return [] }
+
+            return (0..<segmentCount).compactMap { index in
+                let infoOffset = Int(blob.loadUnaligned(fromByteOffset: startsOffset + 4 + index * 4, as: UInt32.self))
+                // pointer_format follows size (u32) and page_size (u16)
+                let formatOffset = startsOffset + infoOffset + 6
+                guard infoOffset > 0, formatOffset + 2 <= blobSize,
+                      let format = PointerFormat(rawValue: blob.loadUnaligned(fromByteOffset: formatOffset, as: UInt16.self)) else {
+                    return nil
+                }
+                return (index, format)
+            }
+        }
+
+        /// File offsets of the pointer-sized entries of section `name`, in
+        /// whichever data segment holds it.
+        func entries(of name: StaticString) -> StrideTo<Int> {
+            let section = slice.section("__DATA_CONST", name) ?? slice.section("__DATA", name) ?? slice.section("__DATA_DIRTY", name)
+            guard let section, let contents = slice.contents(of: section) else {
+                return stride(from: 0, to: 0, by: 8)
+            }
+
+            let start = slice.base.distance(to: contents.baseAddress!)
+            return stride(from: start, to: start + contents.count - 7, by: 8)
+        }
+
+        func pointer(at offset: Int) -> Pointer {
+            guard offset >= 0, offset + 8 <= slice.size else { return .none }
+            let raw = slice.base.loadUnaligned(fromByteOffset: offset, as: UInt64.self)
+
+            guard let segment = segments.first(where: { UInt64(offset) >= $0.fileoff && UInt64(offset) < $0.fileoff + $0.filesize }),
+                  let format = segment.format else {
+                // No chains: the file holds the unslid address
+                return raw == 0 ? .none : rebase(address: raw)
+            }
+
+            switch format {
+            case .pointer64, .pointer64Offset:
+                if raw >> 63 != 0 {
+                    return bind(Int(raw & 0xff_ffff))
+                }
+                let target = raw & 0xf_ffff_ffff
+                return rebase(address: format == .pointer64 ? target : imageBase + target)
+
+            case .arm64e, .arm64eUserland, .arm64eUserland24:
+                let isAuth = raw >> 63 != 0
+                if raw >> 62 & 1 != 0 {
+                    return bind(Int(raw & (format == .arm64eUserland24 ? 0xff_ffff : 0xffff)))
+                }
+                if isAuth {
+                    return rebase(address: imageBase + (raw & 0xffff_ffff))
+                }
+                let target = raw & 0x7ff_ffff_ffff
+                return rebase(address: format == .arm64e ? target : imageBase + target)
+            }
+        }
+
+        /// The name in the class_ro_t of the class_t at file offset `offset`.
+        func className(ofClassAt offset: Int) -> String? {
+            // class_t: isa, superclass, cache, vtable, then data (class_ro_t *
+            // with flag bits in the low 3 bits)
+            guard case .rebase(let data) = pointer(at: offset + 32) else { return nil }
+
+            // class_ro_t: flags, instanceStart, instanceSize, reserved, ivarLayout, then name
+            guard case .rebase(let name) = pointer(at: (data & ~7) + 24) else { return nil }
+            return cString(at: name)
+        }
+
+        private func bind(_ index: Int) -> Pointer {
+            imports.indices.contains(index) ? .bind(imports[index]) : .none
+        }
+
+        private func rebase(address: UInt64) -> Pointer {
+            guard let segment = segments.first(where: { address >= $0.vmaddr && address < $0.vmaddr + $0.filesize && $0.filesize > 0 }) else {
+                return .none
+            }
+            return .rebase(Int(segment.fileoff + (address - segment.vmaddr)))
+        }
+
+        private func cString(at offset: Int) -> String? {
+            guard offset > 0, offset < slice.size else { return nil }
+            let bytes = UnsafeRawBufferPointer(start: slice.base.advanced(by: offset), count: min(slice.size - offset, 1024))
+            guard let end = bytes.firstIndex(of: 0) else { return nil }
+            return String(decoding: bytes[..<end], as: UTF8.self)
+        }
+    }
+}
@@ -0,0 +1,315 @@
+//
+//  PatchCache.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import CryptoKit
+import Darwin
+import Foundation
+
+/// Content-addressed store of patched images. Entries live in
+/// `Caches/PatchedImages/<key>/` where the key is a SHA-256 of the original
+/// file plus the version of the patch rules, so relaunching the same binary
+/// skips patching entirely and two binaries with the same name never collide.
+final class PatchCache {
+    static let shared = PatchCache()
+
+    /// Bump whenever the patch pipeline changes the bytes it writes.
+    static let pipelineVersion = 2
+
+    static let budgetDefaultsKey = "PatchCacheBudgetMB"
+    static let defaultBudgetMB = 2048
+
+    let directory: URL
+
+    /// Digests remembered for files no longer in use are dropped past this,
+    /// least recently used first.
+    static let digestIndexLimit = 4096
+
+    private struct DigestRecord: Codable {
+        let digest: String
+        var lastUsed: Date
+    }
+
+    private let lock = NSLock()
+    private var digests: [String: DigestRecord]?
+    private var digestsDirty = false
+    private var digestSaveScheduled = false
+
+    private var digestIndexURL: URL {
+        directory.appendingPathComponent("digests.json")
+    }
+
+    /// Disk budget for all cached images, configurable through `PatchCacheBudgetMB`.
+    var budget: Int64 {
+        let megabytes = UserDefaults.standard.object(forKey: Self.budgetDefaultsKey) as? Int ?? Self.defaultBudgetMB
+        return Int64(megabytes) * 1024 * 1024
+    }
+
+    init(directory: URL = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0].appendingPathComponent("PatchedImages")) {
+        self.directory = directory
+        try? FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+    }
+
+    /// Cache key for `fileURL` patched with the rule set identified by `ruleVersion`.
+    func key(for fileURL: URL, ruleVersion: String) throws -> String {
+        let digest = try contentDigest(of: fileURL)
+        saveDigests()
+        let combined = SHA256.hash(data: Data("\(digest)|\(ruleVersion)|\(Self.pipelineVersion)".utf8))
+        return combined.map { String(format: "%02x", $0) }.joined()
+    }
+
+    func entryDirectory(for key: String) -> URL {
+        directory.appendingPathComponent(key, isDirectory: true)
+    }
+
+    /// Returns the cached image for `key` and marks it as recently used.
+    func lookup(_ key: String, name: String) -> URL? {
+        let entry = entryDirectory(for: key)
+        let image = entry.appendingPathComponent(name)
+
+        guard FileManager.default.fileExists(atPath: image.path) else { return nil }
+
+        try? FileManager.default.setAttributes([.modificationDate: Date()], ofItemAtPath: entry.path)
+        return image
+    }
+
+    /// A private directory to patch into before the result is published with `store`.
+    func makeStagingDirectory(for key: String) throws -> URL {
+        let staging = directory.appendingPathComponent(".\(key)-\(UUID().uuidString)", isDirectory: true)
+        try FileManager.default.createDirectory(at: staging, withIntermediateDirectories: true)
+        return staging
+    }
+
+    /// Atomically publishes a staging directory as the entry for `key` and evicts
+    /// old entries if the cache is over budget. If another patch of the same input
+    /// won the race, its entry is kept and the staging copy is dropped. Returns
+    /// nil when the entry couldn't be published at all.
+    func store(_ staging: URL, for key: String) -> URL? {
+        let entry = entryDirectory(for: key)
+
+        if rename(staging.path, entry.path) != 0 {
+            let error = errno
+            try? FileManager.default.removeItem(at: staging)
+
+            // Only these mean the entry is already there
+            guard error == EEXIST || error == ENOTEMPTY, FileManager.default.fileExists(atPath: entry.path) else {
+                NSLog("Failed to store patched image \(key): \(String(cString: strerror(error)))")
+                return nil
+            }
+        }
+
+        evictIfNeeded(keeping: key)
+        return entry
+    }
+
+    // MARK: - Recipes
+
+    /// Recipes live outside the entries so that a small one outlasts eviction
+    /// of the image it describes. Most are a few kilobytes, but with
+    /// `SlimLinkedit` or `adHocSign` a recipe holds the old and new bytes of
+    /// the whole rewritten __LINKEDIT and signature; anything over
+    /// `recipeSizeLimit` counts against the budget with its entry and is
+    /// evicted along with it.
+    var recipesDirectory: URL {
+        directory.deletingLastPathComponent().appendingPathComponent("PatchRecipes", isDirectory: true)
+    }
+
+    static let recipeSizeLimit: Int64 = 256 * 1024
+
+    private func recipeURL(for key: String) -> URL {
+        recipesDirectory.appendingPathComponent(key + ".recipe")
+    }
+
+    func recipe(for key: String) -> PatchRecipe? {
+        let url = recipeURL(for: key)
+        guard let data = try? Data(contentsOf: url, options: .mappedIfSafe) else { return nil }
+
+        do {
+            return try PatchRecipe(data: data)
+        } catch {
+            NSLog("Dropping unreadable recipe \(key): \(error)")
+            try? FileManager.default.removeItem(at: url)
+            return nil
+        }
+    }
+
+    func storeRecipe(_ recipe: PatchRecipe, for key: String) {
+        do {
+            try FileManager.default.createDirectory(at: recipesDirectory, withIntermediateDirectories: true)
+            try recipe.serialized().write(to: recipeURL(for: key), options: .atomic)
+        } catch {
+            NSLog("Failed to store patch recipe: \(error)")
+        }
+    }
+
+    func discard(_ staging: URL) {
+        try? FileManager.default.removeItem(at: staging)
+    }
+
+    /// Removes least recently used entries until the cache fits its budget.
+    func evictIfNeeded(keeping key: String? = nil) {
+        let fileManager = FileManager.default
+        let keys: [URLResourceKey] = [.isDirectoryKey, .contentModificationDateKey]
+
+        guard let contents = try? fileManager.contentsOfDirectory(at: directory, includingPropertiesForKeys: keys, options: [.skipsHiddenFiles]) else {
+            return
+        }
+
+        var entries: [(url: URL, date: Date, size: Int64, largeRecipe: URL?)] = []
+        var total: Int64 = 0
+
+        for url in contents {
+            guard let values = try? url.resourceValues(forKeys: Set(keys)), values.isDirectory == true else { continue }
+
+            var size = allocatedSize(of: url)
+            let recipe = recipeURL(for: url.lastPathComponent)
+            let recipeSize = Int64((try? recipe.resourceValues(forKeys: [.totalFileAllocatedSizeKey]))?.totalFileAllocatedSize ?? 0)
+            let largeRecipe = recipeSize > Self.recipeSizeLimit ? recipe : nil
+            if largeRecipe != nil {
+                size += recipeSize
+            }
+
+            total += size
+            entries.append((url, values.contentModificationDate ?? .distantPast, size, largeRecipe))
+        }
+
+        let budget = self.budget
+        guard total > budget else { return }
+
+        for entry in entries.sorted(by: { $0.date < $1.date }) where total > budget {
+            guard entry.url.lastPathComponent != key else { continue }
+
+            do {
+                try fileManager.removeItem(at: entry.url)
+                if let recipe = entry.largeRecipe {
+                    try? fileManager.removeItem(at: recipe)
+                }
+                total -= entry.size
+                NSLog("Evicted patched image \(entry.url.lastPathComponent)")
+            } catch {
+                NSLog("Failed to evict \(entry.url.lastPathComponent): \(error)")
+            }
+        }
+    }
+
+    private func allocatedSize(of directory: URL) -> Int64 {
+        guard let enumerator = FileManager.default.enumerator(at: directory, includingPropertiesForKeys: [.totalFileAllocatedSizeKey]) else {
+            return 0
+        }
+
+        var size: Int64 = 0
+        for case let url as URL in enumerator {
+            size += Int64((try? url.resourceValues(forKeys: [.totalFileAllocatedSizeKey]))?.totalFileAllocatedSize ?? 0)
+        }
+        return size
+    }
+
+    // MARK: - Content digests
+
+    /// SHA-256 of the file contents. Digests are remembered per (device, inode,
+    /// size, mtime), so an unchanged input is only ever hashed once. The index
+    /// is written out by `key(for:ruleVersion:)` or shortly after the last new
+    /// digest, not once per file.
+    func contentDigest(of fileURL: URL) throws -> String {
+        var fileStat = stat()
+        guard stat(fileURL.path, &fileStat) == 0 else {
+            throw MachOError.posix("Failed to stat", fileURL.path)
+        }
+
+        let identity = "\(fileStat.st_dev):\(fileStat.st_ino):\(fileStat.st_size):\(fileStat.st_mtimespec.tv_sec).\(fileStat.st_mtimespec.tv_nsec)"
+
+        if let digest = cachedDigest(for: identity) {
+            return digest
+        }
+
+        let digest = try hashFile(at: fileURL.path)
+        rememberDigest(digest, for: identity)
+        return digest
+    }
+
+    private func hashFile(at path: String) throws -> String {
+        let fd = open(path, O_RDONLY)
+        guard fd >= 0 else {
+            throw MachOError.posix("Failed to open", path)
+        }
+        defer { close(fd) }
+
+        var fileStat = stat()
+        guard fstat(fd, &fileStat) == 0 else {
+            throw MachOError.posix("Failed to stat", path)
+        }
+
+        var hasher = SHA256()
+        let size = Int(fileStat.st_size)
+
+        if size > 0 {
+            guard let map = mmap(nil, size, PROT_READ, MAP_PRIVATE, fd, 0), map != MAP_FAILED else {
+                throw MachOError.posix("Failed to map", path)
+            }
+            defer { munmap(map, size) }
+
+            madvise(map, size, MADV_SEQUENTIAL)
+            hasher.update(bufferPointer: UnsafeRawBufferPointer(start: map, count: size))
+        }
+
+        return hasher.finalize().map { String(format: "%02x", $0) }.joined()
+    }
+
+    private func cachedDigest(for identity: String) -> String? {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if digests == nil {
+            // An index in an older format is simply rebuilt
+            digests = (try? Data(contentsOf: digestIndexURL)).flatMap { try? JSONDecoder().decode([String: DigestRecord].self, from: $0) } ?? [:]
+        }
+        guard let record = digests?[identity] else { return nil }
+
+        // Only worth a write when it moves the entry well away from eviction
+        if record.lastUsed.timeIntervalSinceNow < -86_400 {
+            digests?[identity]?.lastUsed = Date()
+            digestsDirty = true
+        }
+        return record.digest
+    }
+
+    private func rememberDigest(_ digest: String, for identity: String) {
+        lock.lock()
+        defer { lock.unlock() }
+
+        digests?[identity] = DigestRecord(digest: digest, lastUsed: Date())
+        digestsDirty = true
+
+        // Hashing a whole bundle remembers hundreds in a row; write once after them
+        guard !digestSaveScheduled else { return }
+        digestSaveScheduled = true
+        DispatchQueue.global(qos: .utility).asyncAfter(deadline: .now() + 1) { [weak self] in
+            self?.saveDigests()
+        }
+    }
+
+    /// Writes the digest index if it changed, trimmed to `digestIndexLimit`.
+    func saveDigests() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        digestSaveScheduled = false
+        guard digestsDirty, var digests else { return }
+
+        if digests.count > Self.digestIndexLimit {
+            let stale = digests.sorted { $0.value.lastUsed < $1.value.lastUsed }.prefix(digests.count - Self.digestIndexLimit)
+            for (identity, _) in stale {
+                digests[identity] = nil
+            }
+            self.digests = digests
+        }
+
+        if let data = try? JSONEncoder().encode(digests) {
+            try? data.write(to: digestIndexURL, options: .atomic)
+        }
+        digestsDirty = false
+    }
+}
@@ -0,0 +1,203 @@
+//
+//  PatchRecipe.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+
+/// A finished patch written down as byte edits against the unpatched copy
+/// (the clone or thinned slice `MachOPatcher` starts from). Replaying it is a
+/// handful of pread/pwrite calls with no Mach-O parsing, and every edit carries
+/// the bytes it expects to replace so a recipe never lands on the wrong input.
+struct PatchRecipe {
+    static let magic: UInt32 = 0x4352_504d // "MPRC"
+    static let version: UInt32 = 1
+
+    struct Edit {
+        let offset: Int
+        let old: [UInt8]
+        let new: [UInt8]
+    }
+
+    /// SHA-256 of the original file, as hex.
+    let inputDigest: String
+    let baseLength: Int
+    let outputLength: Int
+    let edits: [Edit]
+    /// Bytes past `baseLength` when the patch grew the file.
+    let tail: [UInt8]
+
+    /// Diffs `patched` against `base`. Runs of changes closer than `mergeGap`
+    /// bytes become one edit, which keeps the recipe and the write count small.
+    static func record(base: UnsafeRawBufferPointer, patched: UnsafeRawBufferPointer, inputDigest: String, mergeGap: Int = 16) -> PatchRecipe {
+        let common = min(base.count, patched.count)
+        let pageSize = 4096
+        var runs: [Range<Int>] = []
+
+        var page = 0
+        while page < common {
+            let length = min(pageSize, common - page)
+
+            if memcmp(base.baseAddress! + page, patched.baseAddress! + page, length) != 0 {
+                for i in page..<page + length where base[i] != patched[i] {
+                    if let last = runs.last, i - last.upperBound < mergeGap {
+                        runs[runs.count - 1] = last.lowerBound..<i + 1
+                    } else {
+                        runs.append(i..<i + 1)
+                    }
+                }
+            }
+            page += length
+        }
+
+        let edits = runs.map { Edit(offset: $0.lowerBound, old: Array(base[$0]), new: Array(patched[$0])) }
+        let tail = patched.count > base.count ? Array(patched[base.count...]) : []
+
+        return PatchRecipe(inputDigest: inputDigest, baseLength: base.count, outputLength: patched.count, edits: edits, tail: tail)
+    }
+
+    init(inputDigest: String, baseLength: Int, outputLength: Int, edits: [Edit], tail: [UInt8]) {
+        self.inputDigest = inputDigest
+        self.baseLength = baseLength
+        self.outputLength = outputLength
+        self.edits = edits
+        self.tail = tail
+    }
+
+    // MARK: - Serialisation
+
+    /// Layout, all little endian: magic, version, pipeline version, edit count
+    /// (u32 each), base length, output length, tail length (u64 each), the
+    /// 32-byte input digest, then per edit offset (u64), length (u32), old and
+    /// new bytes, and finally the tail.
+    func serialized() -> Data {
+        var data = Data()
+        data.reserveCapacity(72 + edits.reduce(tail.count) { $0 + 12 + $1.old.count * 2 })
+
+        func append<T: FixedWidthInteger>(_ value: T) {
+            withUnsafeBytes(of: value.littleEndian) { data.append(contentsOf: $0) }
+        }
+
+        append(Self.magic)
+        append(Self.version)
+        append(UInt32(PatchCache.pipelineVersion))
+        append(UInt32(edits.count))
+        append(UInt64(baseLength))
+        append(UInt64(outputLength))
+        append(UInt64(tail.count))
+        data.append(contentsOf: Self.digestBytes(inputDigest))
+
+        for edit in edits {
+            append(UInt64(edit.offset))
+            append(UInt32(edit.new.count))
+            data.append(contentsOf: edit.old)
+            data.append(contentsOf: edit.new)
+        }
+
+        data.append(contentsOf: tail)
+        return data
+    }
+
+    init(data: Data) throws {
+        var cursor = data.startIndex
+
+        func read<T: FixedWidthInteger>(_ type: T.Type) throws -> T {
+            let size = MemoryLayout<T>.size
+            guard data.endIndex - cursor >= size else { throw MachOError("Truncated patch recipe") }
+            var value: T = 0
+            withUnsafeMutableBytes(of: &value) { data.copyBytes(to: $0, from: cursor..<cursor + size) }
+            cursor += size
+            return T(littleEndian: value)
+        }
+
+        func bytes(_ count: Int) throws -> [UInt8] {
+            guard count >= 0, data.endIndex - cursor >= count else { throw MachOError("Truncated patch recipe") }
+            defer { cursor += count }
+            return Array(data[cursor..<cursor + count])
+        }
+
+        guard try read(UInt32.self) == Self.magic, try read(UInt32.self) == Self.version else {
+            throw MachOError("Not a current patch recipe")
+        }
+        guard try read(UInt32.self) == UInt32(PatchCache.pipelineVersion) else {
+            throw MachOError("Patch recipe was recorded by another pipeline version")
+        }
+
+        let editCount = Int(try read(UInt32.self))
+        baseLength = Int(try read(UInt64.self))
+        outputLength = Int(try read(UInt64.self))
+        let tailLength = Int(try read(UInt64.self))
+        inputDigest = try bytes(32).map { String(format: "%02x", $0) }.joined()
+
+        var edits: [Edit] = []
+        edits.reserveCapacity(editCount)
+        for _ in 0..<editCount {
+            let offset = Int(try read(UInt64.self))
+            let length = Int(try read(UInt32.self))
+            edits.append(Edit(offset: offset, old: try bytes(length), new: try bytes(length)))
+        }
+
+        self.edits = edits
+        tail = try bytes(tailLength)
+    }
+
+    private static func digestBytes(_ hex: String) -> [UInt8] {
+        var bytes: [UInt8] = []
+        var index = hex.startIndex
+        while let next = hex.index(index, offsetBy: 2, limitedBy: hex.endIndex), bytes.count < 32 {
+            bytes.append(UInt8(hex[index..<next], radix: 16) ?? 0)
+            index = next
+        }
+        return bytes + [UInt8](repeating: 0, count: 32 - bytes.count)
+    }
+
+    // MARK: - Replay
+
+    /// Replays the recipe onto the unpatched copy at `path`. Fails without
+    /// writing anything if the copy isn't the input the recipe was recorded on.
+    func apply(to path: String) throws {
+        let fd = open(path, O_RDWR)
+        guard fd >= 0 else {
+            throw MachOError.posix("Failed to open", path)
+        }
+        defer { close(fd) }
+
+        var fileStat = stat()
+        guard fstat(fd, &fileStat) == 0 else {
+            throw MachOError.posix("Failed to stat", path)
+        }
+        guard Int(fileStat.st_size) == baseLength else {
+            throw MachOError("\(path) is \(fileStat.st_size) bytes, recipe expects \(baseLength)")
+        }
+
+        var current = [UInt8](repeating: 0, count: edits.map(\.old.count).max() ?? 0)
+        for edit in edits {
+            let count = edit.old.count
+            guard pread(fd, &current, count, off_t(edit.offset)) == count,
+                  current.prefix(count).elementsEqual(edit.old) else {
+                throw MachOError("\(path) doesn't match the recipe at offset \(edit.offset)")
+            }
+        }
+
+        for edit in edits {
+            guard pwrite(fd, edit.new, edit.new.count, off_t(edit.offset)) == edit.new.count else {
+                throw MachOError.posix("Failed to write", path)
+            }
+        }
+
+        if outputLength != baseLength {
+            guard ftruncate(fd, off_t(outputLength)) == 0 else {
+                throw MachOError.posix("Failed to resize", path)
+            }
+        }
+
+        if !tail.isEmpty {
+            guard pwrite(fd, tail, tail.count, off_t(baseLength)) == tail.count else {
+                throw MachOError.posix("Failed to write", path)
+            }
+        }
+    }
+}
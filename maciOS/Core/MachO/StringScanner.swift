@@ -0,0 +1,217 @@
+//
+//  StringScanner.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Darwin
+import Foundation
+import MachO
+
+/// Aho-Corasick automaton over a fixed set of byte patterns, compiled into a
+/// dense 256-way transition table. Scanning is one table lookup per byte no
+/// matter how many patterns there are. While the automaton sits in its root
+/// state and every pattern starts with the same byte, it skips ahead with
+/// memchr, which libc vectorises.
+struct MultiPatternScanner {
+    let patterns: [[UInt8]]
+    
+    private let transitions: [Int32]
+    /// Pattern ending at each state, or -1.
+    private let matches: [Int32]
+    /// Nearest state on the failure chain that also ends a pattern, or -1.
+    private let outputLinks: [Int32]
+    private let leadByte: UInt8?
+    
+    init(_ patterns: [[UInt8]]) {
+        self.patterns = patterns
+        
+        var transitions = [Int32](repeating: -1, count: 256)
+        var matches: [Int32] = [-1]
+        
+        for (index, pattern) in patterns.enumerated() where !pattern.isEmpty {
+            var state = 0
+            for byte in pattern {
+                let slot = state << 8 | Int(byte)
+                if transitions[slot] < 0 {
+                    transitions[slot] = Int32(matches.count)
+                    transitions.append(contentsOf: repeatElement(-1, count: 256))
+                    matches.append(-1)
+                }
+                state = Int(transitions[slot])
+            }
+            
+            // Duplicate patterns keep the first rule, same as the old tuple order.
+            if matches[state] < 0 {
+                matches[state] = Int32(index)
+            }
+        }
+        
+        var failures = [Int32](repeating: 0, count: matches.count)
+        var outputLinks = [Int32](repeating: -1, count: matches.count)
+        var queue: [Int] = []
+        
+        for byte in 0..<256 {
+            let next = transitions[byte]
+            if next < 0 {
+                transitions[byte] = 0
+            } else {
+                queue.append(Int(next))
+            }
+        }
+        
+        // Breadth first, so a state's failure target is always fully resolved
+        // before the state itself borrows its transitions.
+        var head = 0
+        while head < queue.count {
+            let state = queue[head]
+            head += 1
+            
+            let failure = Int(failures[state])
+            outputLinks[state] = matches[failure] >= 0 ? Int32(failure) : outputLinks[failure]
+            
+            for byte in 0..<256 {
+                let slot = state << 8 | byte
+                let fallback = transitions[failure << 8 | byte]
+                let next = transitions[slot]
+                
+                if next < 0 {
+                    transitions[slot] = fallback
+                } else {
+                    failures[Int(next)] = fallback
+                    queue.append(Int(next))
+                }
+            }
+        }
+        
+        self.transitions = transitions
+        self.matches = matches
+        self.outputLinks = outputLinks
+        
+        let leads = Set(patterns.compactMap(\.first))
+        leadByte = leads.count == 1 ? leads.first : nil
+    }
+    
+    /// Calls `body` with the start offset and pattern index of every match in
+    /// `buffer`, in order of where the match ends.
+    func scan(_ buffer: UnsafeRawBufferPointer, _ body: (_ offset: Int, _ pattern: Int) -> Void) {
+        guard let start = buffer.baseAddress, matches.count > 1 else { return }
+        let bytes = start.assumingMemoryBound(to: UInt8.self)
+        let count = buffer.count
+        
+        transitions.withUnsafeBufferPointer { table in
+            matches.withUnsafeBufferPointer { matches in
+                outputLinks.withUnsafeBufferPointer { outputLinks in
+                    var state = 0
+                    var i = 0
+                    
+                    while i < count {
+                        if state == 0, let leadByte {
+                            guard let hit = memchr(start.advanced(by: i), Int32(leadByte), count - i) else { return }
+                            i = start.distance(to: UnsafeRawPointer(hit))
+                        }
+                        
+                        state = Int(table[state << 8 | Int(bytes[i])])
+                        
+                        var output = matches[state] >= 0 ? state : Int(outputLinks[state])
+                        while output >= 0 {
+                            let pattern = Int(matches[output])
+                            body(i + 1 - patterns[pattern].count, pattern)
+                            output = Int(outputLinks[output])
+                        }
+                        
+                        i += 1
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Rewrites framework paths that survive as string literals, for guests that
+/// dlopen() them directly. Only the sections that can hold such literals are
+/// scanned, in a single pass for the literal start of every rule; each string
+/// found that way is then looked up whole in the remap rules.
+struct FrameworkStringRemapper {
+    struct Hit {
+        /// Offset from the start of the slice.
+        let offset: Int
+        /// End of the section the hit is in, also from the start of the slice.
+        let sectionEnd: Int
+    }
+    
+    static let scannedSections: [(StaticString, StaticString)] = [
+        ("__TEXT", "__cstring"),
+        ("__DATA", "__const"),
+        ("__DATA_CONST", "__const"),
+    ]
+    
+    private let rules: FrameworkRemapRules
+    private let scanner: MultiPatternScanner
+    
+    init(_ rules: FrameworkRemapRules) {
+        self.rules = rules
+        scanner = MultiPatternScanner(rules.triggers)
+    }
+    
+    /// Every trigger match, once per start offset and sorted by offset, so
+    /// hits from different sections come in file order whatever order the
+    /// sections are scanned in.
+    func hits(in slice: MachOSlice) -> [Hit] {
+        var hits: [Hit] = []
+        var starts = Set<Int>()
+        
+        for (segmentName, sectionName) in Self.scannedSections {
+            guard let section = slice.section(segmentName, sectionName),
+                  let contents = slice.contents(of: section) else { continue }
+            
+            let sectionOffset = slice.base.distance(to: contents.baseAddress!)
+            let sectionEnd = sectionOffset + contents.count
+            scanner.scan(UnsafeRawBufferPointer(contents)) { offset, _ in
+                // Several triggers can start at the same byte; the string is the
+                // same. Matches come in end order, so that byte isn't always the last hit.
+                if starts.insert(sectionOffset + offset).inserted {
+                    hits.append(Hit(offset: sectionOffset + offset, sectionEnd: sectionEnd))
+                }
+            }
+        }
+        
+        return hits.sorted { $0.offset < $1.offset }
+    }
+    
+    /// Rewrites every string with a remap in place and returns how many were
+    /// rewritten. Longer replacements can't be stored without moving the rest
+    /// of the section, so they are reported and left alone.
+    @discardableResult
+    func rewrite(_ slice: MachOSlice) -> Int {
+        var rewritten = 0
+        var lastEnd = 0
+        
+        for hit in hits(in: slice) {
+            // A trigger that matched inside an already rewritten path
+            guard hit.offset >= lastEnd else { continue }
+            
+            let target = slice.base.advanced(by: hit.offset)
+            let available = hit.sectionEnd - hit.offset
+            let length = strnlen(target.assumingMemoryBound(to: CChar.self), available)
+            guard length < available else { continue }
+            
+            let original = String(decoding: UnsafeRawBufferPointer(start: target, count: length), as: UTF8.self)
+            guard let replacement = rules.replacement(for: original) else { continue }
+            
+            guard replacement.utf8.count <= length else {
+                NSLog("Skipping string \(original): replacement is longer than the original")
+                continue
+            }
+            
+            replacement.utf8CString.withUnsafeBytes { target.copyMemory(from: $0.baseAddress!, byteCount: $0.count - 1) }
+            memset(target.advanced(by: replacement.utf8.count), 0, length - replacement.utf8.count)
+            
+            lastEnd = hit.offset + length
+            rewritten += 1
+        }
+        
+        return rewritten
+    }
+}
@@ -0,0 +1,296 @@
+//
+//  StubDylibBuilder.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import CryptoKit
+import Darwin
+import Foundation
+import MachO
+
+/// Generates a small arm64 dylib that exports a stub for each symbol a guest
+/// imports but nothing on iOS provides. A function stub zeroes x0 and d0-d3
+/// (or loads the constant configured for it into x0) and returns; a data
+/// symbol (`_kFoo`) is a zero-filled block, so it reads as 0/NULL.
+///
+/// Stub dylibs are cached in `Caches/StubDylibs/` by a hash of the symbol set
+/// and constants, and ad-hoc signed once when built. The patcher copies the
+/// stub next to the image and points the imports at `@loader_path/<name>`,
+/// so the guest binds through dyld like it would to any other library.
+struct StubDylibBuilder {
+    static let constantsDefaultsKey = "StubConstants"
+    /// Bump whenever the generated bytes change.
+    static let version = 1
+    static let namePrefix = "maciOS-stubs-"
+
+    /// Every stub takes the same space, so stub `i` is at a fixed offset.
+    private static let stubSize = 40
+    private static let pageSize = 0x4000
+    /// Left free after the load commands for LC_CODE_SIGNATURE and the like.
+    private static let headerPadding = 256
+
+    static var directory: URL {
+        FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0].appendingPathComponent("StubDylibs", isDirectory: true)
+    }
+
+    /// Values returned by specific stubs instead of 0.
+    let constants: [String: UInt64]
+
+    /// `constants` defaults to the `StubConstants` dictionary in UserDefaults.
+    init(constants: [String: UInt64]? = nil) {
+        self.constants = constants ?? (UserDefaults.standard.dictionary(forKey: Self.constantsDefaultsKey) ?? [:]).compactMapValues {
+            ($0 as? NSNumber).map { UInt64(bitPattern: $0.int64Value) }
+        }
+    }
+
+    /// Identifies the builder and its constants for the patch cache key.
+    var configurationVersion: String {
+        let constants = self.constants.sorted { $0.key < $1.key }.map { "\($0.key)=\($0.value)" }.joined(separator: ",")
+        return "\(Self.version):\(constants)"
+    }
+
+    /// Objective-C classes and metaclasses can't be faked with zero bytes.
+    static func canStub(_ symbol: String) -> Bool {
+        !symbol.hasPrefix("_OBJC_") && !symbol.hasPrefix(".objc_")
+    }
+
+    /// Global constants, going by the `kSomething` naming convention.
+    static func isData(_ symbol: String) -> Bool {
+        let utf8 = Array(symbol.utf8)
+        return utf8.count > 2 && utf8[0] == UInt8(ascii: "_") && utf8[1] == UInt8(ascii: "k") && (UInt8(ascii: "A")...UInt8(ascii: "Z")).contains(utf8[2])
+    }
+
+    /// File name of the stub dylib for `symbols`; the same set always gets the same name.
+    func fileName(for symbols: [String]) -> String {
+        var hasher = SHA256()
+        hasher.update(data: Data(configurationVersion.utf8))
+        for symbol in Set(symbols).sorted() {
+            hasher.update(data: Data("\n\(symbol)".utf8))
+        }
+        let digest = hasher.finalize().prefix(16).map { String(format: "%02x", $0) }.joined()
+        return Self.namePrefix + digest + ".dylib"
+    }
+
+    /// Places the stub dylib for `symbols` next to `image` under `name`
+    /// (default `fileName(for:)`), building it into the cache first if needed.
+    /// Returns the install name to load it by.
+    @discardableResult
+    func install(_ symbols: [String], beside image: URL, as name: String? = nil) throws -> String {
+        let name = name ?? fileName(for: symbols)
+        let cached = Self.directory.appendingPathComponent(name)
+
+        if !FileManager.default.fileExists(atPath: cached.path) {
+            try FileManager.default.createDirectory(at: Self.directory, withIntermediateDirectories: true)
+
+            let staging = Self.directory.appendingPathComponent(".\(name)-\(UUID().uuidString)")
+            try Data(build(symbols, installName: "@loader_path/" + name)).write(to: staging)
+            try CodeSigner(identifier: (name as NSString).deletingPathExtension).sign(staging.path)
+
+            // Another patch may have built the same set meanwhile; either copy is fine
+            if rename(staging.path, cached.path) != 0 {
+                try? FileManager.default.removeItem(at: staging)
+            }
+            NSLog("Built stub dylib \(name) for \(symbols.count) symbols")
+        }
+
+        let destination = image.deletingLastPathComponent().appendingPathComponent(name)
+        if FileManager.default.fileExists(atPath: destination.path) {
+            try FileManager.default.removeItem(at: destination)
+        }
+        if copyfile(cached.path, destination.path, nil, copyfile_flags_t(COPYFILE_CLONE | COPYFILE_ALL)) != 0 {
+            throw MachOError.posix("Failed to copy", destination.path)
+        }
+
+        return "@loader_path/" + name
+    }
+
+    // MARK: - Image
+
+    /// A thin arm64 MH_DYLIB with one __TEXT section holding the stubs and an
+    /// export trie in __LINKEDIT; no imports, so nothing to bind or rebase.
+    func build(_ symbols: [String], installName: String) -> [UInt8] {
+        let symbols = Set(symbols).sorted()
+
+        let idCommand = MachOSlice.dylibCommand(MachOLoadCommand.idDylib, path: installName)
+        let commandsSize = (72 + 80) + 72 + idCommand.count + 16 + 24 + 80 + 24
+        let headerSize = MemoryLayout<mach_header_64>.size
+
+        let textOffset = Self.align(headerSize + commandsSize + Self.headerPadding, 16)
+        let textSize = symbols.count * Self.stubSize
+        let textSegmentSize = Self.align(textOffset + textSize, Self.pageSize)
+
+        var linkedit = ByteWriter()
+        linkedit.bytes = Self.exportTrie(symbols.enumerated().map { (Array($1.utf8), UInt64(textOffset + $0 * Self.stubSize)) })
+        linkedit.align(8)
+        let stringsOffset = linkedit.count
+        linkedit.bytes += [0x20, 0, 0, 0, 0, 0, 0, 0]
+        let linkeditOffset = textSegmentSize
+
+        var image = ByteWriter()
+        image.u32(MH_MAGIC_64)
+        image.u32(UInt32(bitPattern: CPU_TYPE_ARM64))
+        image.u32(UInt32(bitPattern: CPU_SUBTYPE_ARM64_ALL))
+        image.u32(UInt32(MH_DYLIB))
+        image.u32(7)
+        image.u32(UInt32(commandsSize))
+        image.u32(UInt32(MH_NOUNDEFS | MH_DYLDLINK | MH_TWOLEVEL | MH_NO_REEXPORTED_DYLIBS))
+        image.u32(0)
+
+        image.segment("__TEXT", vmaddr: 0, vmsize: UInt64(textSegmentSize), fileoff: 0, filesize: UInt64(textSegmentSize), prot: 5, sections: 1)
+        image.section("__text", "__TEXT", addr: UInt64(textOffset), size: textSize, offset: textOffset, align: 3, flags: 0x80000400)
+        image.segment("__LINKEDIT", vmaddr: UInt64(textSegmentSize), vmsize: UInt64(Self.align(linkedit.count, Self.pageSize)), fileoff: UInt64(linkeditOffset), filesize: UInt64(linkedit.count), prot: 1, sections: 0)
+        image.bytes += idCommand
+
+        image.u32(MachOLoadCommand.dyldExportsTrie)
+        image.u32(16)
+        image.u32(UInt32(linkeditOffset))
+        image.u32(UInt32(stringsOffset))
+
+        // Empty symbol table, with the customary one-space string table
+        image.u32(MachOLoadCommand.symtab)
+        image.u32(24)
+        image.u32(UInt32(linkeditOffset + stringsOffset))
+        image.u32(0)
+        image.u32(UInt32(linkeditOffset + stringsOffset))
+        image.u32(8)
+
+        image.u32(MachOLoadCommand.dysymtab)
+        image.u32(80)
+        image.bytes += [UInt8](repeating: 0, count: 72)
+
+        image.u32(MachOLoadCommand.buildVersion)
+        image.u32(24)
+        image.u32(MachOPatcher.targetPlatform)
+        image.u32(0x000f_0000) // minos 15.0
+        image.u32(0x000f_0000) // sdk 15.0
+        image.u32(0) // ntools
+
+        image.bytes += [UInt8](repeating: 0, count: textOffset - image.count)
+        for symbol in symbols {
+            image.bytes += stub(for: symbol)
+        }
+        image.bytes += [UInt8](repeating: 0, count: linkeditOffset - image.count)
+        image.bytes += linkedit.bytes
+
+        return image.bytes
+    }
+
+    private func stub(for symbol: String) -> [UInt8] {
+        guard !Self.isData(symbol) else {
+            return [UInt8](repeating: 0, count: Self.stubSize)
+        }
+
+        let value = constants[symbol] ?? 0
+        var code = ByteWriter()
+
+        for register: UInt32 in 0..<4 {
+            code.u32(0x2f00_e400 | register) // movi d<n>, #0
+        }
+        for halfword: UInt32 in 0..<4 {
+            let bits = UInt32(truncatingIfNeeded: value >> (halfword * 16)) & 0xffff
+            // movz x0 for the low halfword, movk x0 for the rest
+            code.u32((halfword == 0 ? 0xd280_0000 : 0xf280_0000) | halfword << 21 | bits << 5)
+        }
+        code.u32(0xd65f_03c0) // ret
+
+        while code.count < Self.stubSize {
+            code.u32(0xd503_201f) // nop
+        }
+        return code.bytes
+    }
+
+    // MARK: - Export trie
+
+    private final class TrieNode {
+        var address: UInt64?
+        var edges: [(label: [UInt8], node: TrieNode)] = []
+        var offset = 0
+    }
+
+    /// Encodes `exports` as a dyld export trie. dyld follows the first edge
+    /// that is a prefix of the name and never backtracks, so sibling edges
+    /// must start with different bytes; building from sorted names with one
+    /// edge per distinct next byte guarantees that.
+    static func exportTrie(_ exports: [(name: [UInt8], address: UInt64)]) -> [UInt8] {
+        let sorted = exports.sorted { $0.name.lexicographicallyPrecedes($1.name) }
+        let root = node(for: sorted[...], depth: 0)
+
+        var nodes: [TrieNode] = []
+        func collect(_ node: TrieNode) {
+            nodes.append(node)
+            node.edges.forEach { collect($0.node) }
+        }
+        collect(root)
+
+        // Child offsets are ULEB128, so a node's size depends on the offsets
+        // after it; iterate until the layout stops moving.
+        var changed = true
+        while changed {
+            changed = false
+            var offset = 0
+            for node in nodes {
+                if node.offset != offset {
+                    node.offset = offset
+                    changed = true
+                }
+                offset += encode(node).count
+            }
+        }
+
+        return nodes.flatMap { encode($0) }
+    }
+
+    private static func node(for exports: ArraySlice<(name: [UInt8], address: UInt64)>, depth: Int) -> TrieNode {
+        let node = TrieNode()
+        var index = exports.startIndex
+
+        if index < exports.endIndex, exports[index].name.count == depth {
+            node.address = exports[index].address
+            index += 1
+        }
+
+        while index < exports.endIndex {
+            let first = exports[index].name
+            var end = index + 1
+            while end < exports.endIndex, exports[end].name[depth] == first[depth] { end += 1 }
+
+            // Sorted, so the first and last names bound the common prefix of the group
+            let last = exports[end - 1].name
+            var common = depth + 1
+            while common < first.count, common < last.count, first[common] == last[common] { common += 1 }
+
+            node.edges.append((Array(first[depth..<common]), Self.node(for: exports[index..<end], depth: common)))
+            index = end
+        }
+
+        return node
+    }
+
+    private static func encode(_ node: TrieNode) -> [UInt8] {
+        var bytes = ByteWriter()
+
+        if let address = node.address {
+            var info = ByteWriter()
+            info.uleb(0) // EXPORT_SYMBOL_FLAGS_KIND_REGULAR
+            info.uleb(address)
+            bytes.uleb(UInt64(info.count))
+            bytes.bytes += info.bytes
+        } else {
+            bytes.u8(0)
+        }
+
+        bytes.u8(UInt8(node.edges.count))
+        for edge in node.edges {
+            bytes.bytes += edge.label
+            bytes.u8(0)
+            bytes.uleb(UInt64(edge.node.offset))
+        }
+        return bytes.bytes
+    }
+
+    private static func align(_ value: Int, _ alignment: Int) -> Int {
+        (value + alignment - 1) / alignment * alignment
+    }
+}
@@ -0,0 +1,158 @@
+//
+//  SymbolNameSet.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import Foundation
+
+/// A fixed set of symbol names compiled into a perfect hash (hash and
+/// displace), for matching against a string table without building a Swift
+/// String per entry. A lookup hashes the C string once, up to its NUL or the
+/// longest name in the set, probes exactly one slot and confirms it with a
+/// length check and memcmp.
+///
+/// Names that can't be given a slot, because their 64-bit hash equals another
+/// name's or no displacement under `maxDisplacement` fits their bucket, are
+/// kept in `overflow` and compared one by one when the probe misses. That
+/// list is empty for any realistic rule set.
+struct SymbolNameSet {
+    let names: [[UInt8]]
+
+    /// Per-bucket displacement, found while building the table.
+    private let displacements: [UInt32]
+    /// Index into `names` for every slot, or -1.
+    private let slots: [Int32]
+    private let slotMask: UInt64
+    private let maxLength: Int
+    /// Indices into `names` that have no slot.
+    private let overflow: [Int]
+
+    private static let maxDisplacement: UInt32 = 1 << 16
+
+    var isEmpty: Bool { names.isEmpty }
+
+    init<S: Sequence>(_ names: S) where S.Element == String {
+        var seen = Set<String>()
+        let unique = names.filter { !$0.isEmpty && seen.insert($0).inserted }
+        self.names = unique.map { Array($0.utf8) }
+        maxLength = self.names.map(\.count).max() ?? 0
+
+        guard !unique.isEmpty else {
+            displacements = []
+            slots = []
+            slotMask = 0
+            overflow = []
+            return
+        }
+
+        // Half full keeps the displacement search short even for large rule sets
+        var slotCount = 1
+        while slotCount < unique.count * 2 { slotCount <<= 1 }
+        let mask = UInt64(slotCount - 1)
+        let bucketCount = max(1, unique.count / 2)
+
+        let hashes = self.names.map { name in
+            (name + [0]).withUnsafeBufferPointer { Self.hash($0.baseAddress!, limit: name.count).hash }
+        }
+
+        // No displacement can separate two equal hashes
+        var seenHashes = Set<UInt64>()
+        var overflow: [Int] = []
+        var buckets = [[Int]](repeating: [], count: bucketCount)
+        for (index, hash) in hashes.enumerated() {
+            if seenHashes.insert(hash).inserted {
+                buckets[Int(hash >> 32) % bucketCount].append(index)
+            } else {
+                overflow.append(index)
+            }
+        }
+
+        var displacements = [UInt32](repeating: 0, count: bucketCount)
+        var slots = [Int32](repeating: -1, count: slotCount)
+
+        // Crowded buckets first, while there is still room to place them
+        for bucket in buckets.indices.sorted(by: { buckets[$0].count > buckets[$1].count }) where !buckets[bucket].isEmpty {
+            var found = false
+            for displacement in 0..<Self.maxDisplacement {
+                let placed = buckets[bucket].map { Self.slot(hashes[$0], displacement, mask) }
+                if Set(placed).count == placed.count, placed.allSatisfy({ slots[$0] < 0 }) {
+                    for (index, slot) in zip(buckets[bucket], placed) {
+                        slots[slot] = Int32(index)
+                    }
+                    displacements[bucket] = displacement
+                    found = true
+                    break
+                }
+            }
+
+            if !found {
+                overflow += buckets[bucket]
+            }
+        }
+
+        if !overflow.isEmpty {
+            NSLog("SymbolNameSet: \(overflow.count) of \(unique.count) names have no slot and are compared linearly")
+        }
+
+        self.displacements = displacements
+        self.slots = slots
+        self.overflow = overflow
+        slotMask = mask
+    }
+
+    /// Index of the NUL-terminated name at `cString` in `names`, if it is in the set.
+    func index(ofCString cString: UnsafePointer<UInt8>) -> Int? {
+        guard !slots.isEmpty else { return nil }
+
+        let (hash, length) = Self.hash(cString, limit: maxLength)
+        guard length <= maxLength else { return nil }
+
+        func matches(_ index: Int) -> Bool {
+            let name = names[index]
+            guard name.count == length else { return false }
+            return name.withUnsafeBufferPointer { memcmp($0.baseAddress!, cString, length) == 0 }
+        }
+
+        let displacement = displacements[Int(hash >> 32) % displacements.count]
+        let candidate = Int(slots[Self.slot(hash, displacement, slotMask)])
+        if candidate >= 0, matches(candidate) {
+            return candidate
+        }
+
+        return overflow.first(where: matches)
+    }
+
+    func index(of name: String) -> Int? {
+        name.withCString { index(ofCString: UnsafeRawPointer($0).assumingMemoryBound(to: UInt8.self)) }
+    }
+
+    func contains(cString: UnsafePointer<UInt8>) -> Bool {
+        index(ofCString: cString) != nil
+    }
+
+    /// FNV-1a over the bytes up to the first NUL. Stops one byte past `limit`,
+    /// so long mangled names that can't be in the set are rejected early.
+    private static func hash(_ bytes: UnsafePointer<UInt8>, limit: Int) -> (hash: UInt64, length: Int) {
+        var hash: UInt64 = 0xcbf29ce484222325
+        var length = 0
+
+        while length <= limit {
+            let byte = bytes[length]
+            if byte == 0 { break }
+            hash = (hash ^ UInt64(byte)) &* 0x100000001b3
+            length += 1
+        }
+
+        return (hash, length)
+    }
+
+    private static func slot(_ hash: UInt64, _ displacement: UInt32, _ mask: UInt64) -> Int {
+        var x = hash &+ UInt64(displacement) &* 0x9e3779b97f4a7c15
+        x ^= x >> 33
+        x &*= 0xff51afd7ed558ccd
+        x ^= x >> 33
+        return Int(x & mask)
+    }
+}
@@ -0,0 +1,70 @@
+//
+//  GuestProcessView.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import SwiftUI
+
+struct GuestProcessView: View {
+    var body: some View {
+        // The table isn't observable, so it is polled, which also keeps CPU time current
+        TimelineView(.periodic(from: .now, by: 1)) { _ in
+            HStack {
+                ForEach(GuestProcessTable.shared.refreshUsage(), id: \.id) { process in
+                    GuestProcessRow(process: process)
+                }
+            }
+        }
+    }
+}
+
+struct GuestProcessRow: View {
+    let process: GuestProcessTable.Process
+    
+    var body: some View {
+        HStack(spacing: 6) {
+            VStack(alignment: .leading, spacing: 2) {
+                Text(process.name)
+                    .font(.caption)
+                    .lineLimit(1)
+                Text(status)
+                    .font(.caption2)
+                    .foregroundColor(isFailure ? .red : .secondary)
+                    .lineLimit(1)
+            }
+            
+            if !process.isAlive && process.threadCount == 0 {
+                Button {
+                    GuestProcessTable.shared.remove(process.id)
+                } label: {
+                    Image(systemName: "xmark.circle")
+                }
+            }
+        }
+    }
+    
+    private var status: String {
+        let cpu = String(format: "%.1fs CPU", process.cpuTime)
+        
+        switch process.state {
+        case .starting:
+            return "Starting"
+        case .running:
+            return "\(process.threadCount) thread\(process.threadCount == 1 ? "" : "s"), \(cpu)"
+        case .exited(let code):
+            return "Exited \(code), \(cpu)"
+        case .failed(let message):
+            return message
+        }
+    }
+    
+    private var isFailure: Bool {
+        switch process.state {
+        case .exited(let code): return code != 0
+        case .failed: return true
+        default: return false
+        }
+    }
+}
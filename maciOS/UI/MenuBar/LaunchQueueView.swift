@@ -0,0 +1,50 @@
+//
+//  LaunchQueueView.swift
+//  maciOS
+//
+//  Created by Stossy11 on 17/10/2026.
+//
+
+import SwiftUI
+
+struct LaunchQueueView: View {
+    @ObservedObject var queue = LaunchQueue.shared
+    
+    var body: some View {
+        HStack {
+            ForEach(queue.jobs) { job in
+                LaunchJobRow(job: job)
+            }
+        }
+    }
+}
+
+struct LaunchJobRow: View {
+    @ObservedObject var job: LaunchJob
+    
+    var body: some View {
+        HStack(spacing: 6) {
+            VStack(alignment: .leading, spacing: 2) {
+                Text(job.name)
+                    .font(.caption)
+                    .lineLimit(1)
+                Text(job.message ?? job.stage.title)
+                    .font(.caption2)
+                    .foregroundColor(job.stage == .failed ? .red : .secondary)
+                    .lineLimit(1)
+                ProgressView(value: job.progress)
+                    .frame(width: 120)
+            }
+            
+            Button {
+                if job.stage.isTerminal {
+                    LaunchQueue.shared.dismiss(job)
+                } else {
+                    job.cancel()
+                }
+            } label: {
+                Image(systemName: job.stage.isTerminal ? "xmark.circle" : "stop.circle")
+            }
+        }
+    }
+}
@@ -16,14 +16,13 @@ struct MenuBarView: View {
         VStack {
             HStack {
                 Button {
-                    FileImporterManager.shared.importFiles(types: [.item]) { result in
+                    FileImporterManager.shared.importFiles(types: [.item, .applicationBundle], allowMultiple: true) { result in
                         switch result {
                         case .success(let urls):
-                            let patcher = MachOPatcher(urls.first!)
-                            machO.append(patcher)
-                            install_exit_hook()
-                            if let url = patcher.patchExecutable() {
-                                Execute.run(dylibPath: url.path)
+                            for url in urls {
+                                LaunchQueue.shared.enqueue(url) { patcher in
+                                    machO.append(patcher)
+                                }
                             }
                         case .failure(_):
                             break
@@ -42,6 +41,10 @@ struct MenuBarView: View {
                         Label("Hide App Logs", systemImage: "cog")
                     }
                 }
+                
+                LaunchQueueView()
+                
+                GuestProcessView()
             }
             
             Spacer()
@@ -6,6 +6,7 @@
 //
 
 import SwiftUI
+import SwiftTerm
 import Combine
 
 protocol WindowRepresentable {
@@ -97,6 +98,13 @@ class WindowViewManager: ObservableObject {
         nativeFloatingWindow.append((shown: true, window: AnyWindowRepresentable(view, title: title)))
     }
     
+    /// Shows the terminal again if it was closed, for command-line guests.
+    public func showTerminal() {
+        for index in nativeFloatingWindow.indices where nativeFloatingWindow[index].window.base is TerminalView {
+            nativeFloatingWindow[index].shown = true
+        }
+    }
+    
     public func removeNativeWindow(at index: Int) {
         guard index < nativeFloatingWindow.count else { return }
         nativeFloatingWindow.remove(at: index)
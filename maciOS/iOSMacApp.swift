@@ -43,6 +43,12 @@ struct maciOSApp: App {
                     
                     let binURL = URL.documentsDirectory.appendingPathComponent("bin")
                     try? FileManager.default.createDirectory(at: binURL, withIntermediateDirectories: false)
+                    
+                    #if DEBUG
+                    if PatcherBenchmark.isRequested {
+                        PatcherBenchmark.runInBackground()
+                    }
+                    #endif
                 }
                 .onAppear {
                     if let window = UIApplication.shared.connectedScenes
@@ -65,11 +71,8 @@ struct maciOSApp: App {
                     NSWindowController.description()
                 }
                 .onOpenURL { url in
-                    let patcher = MachOPatcher(url)
-                    machO.append(patcher)
-                    install_exit_hook()
-                    if let exeURL = patcher.patchExecutable() {
-                        Execute.run(dylibPath: exeURL.path)
+                    handleSharedFile(url) { patcher in
+                        machO.append(patcher)
                     }
                 }
         }